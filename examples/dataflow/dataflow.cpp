@@ -366,19 +366,33 @@ public:
         QSizeF          size;
 
         QVector<Port>   ports;
+
+        bool            committed = false;
     };
 
     QVector<Node>       mNodes;
 
     using DataFlowModel::DataFlowModel;
 
-    NodeID              createNode(const QString &name)
+    NodeID              createNode(const QString &name, const NodeID &node_id=NodeID::invalid())
     {
-        NodeID id = { QUuid::createUuid(), { 0 } };
+        NodeID id = { node_id.isValid() ? node_id.value : QUuid::createUuid(), { 0 } };
         mNodes.append({ id, name, QPointF(0, 0), QSizeF(0, 0), {} });
         return id;
     }
 
+    bool                deleteNode(const NodeID &node) override
+    {
+        int idx = index(node);
+        if (idx < 0)
+            return false;
+
+        disconnect(node);
+        mNodes.remove(idx);
+        notifyNodeDeleted(node);
+        return true;
+    }
+
     PortID              createPort(const NodeID &node, const QString &name, Direction direction)
     {
         int idx = index(node);
@@ -387,12 +401,21 @@ public:
 
         PortID id = { QUuid::createUuid(), { 0 } };
         mNodes[idx].ports.append(Port{ id, name, direction });
+
+        // the scene only knows committed nodes
+        if (mNodes[idx].committed)
+            notifyPortsChanged(node);
+
         return id;
     }
 
     void                commitNode(const NodeID &node)
     {
-        emit nodeCreated(*this, node);
+        int idx = index(node);
+        if (idx >= 0)
+            mNodes[idx].committed = true;
+
+        notifyNodeCreated(node);
     }
 
     int                 index(const NodeID &id) const
@@ -457,6 +480,21 @@ public:
             it = endNode();
     }
 
+    NodeSpan            nodeSpan() const override
+    {
+        return NodeSpan::fromRecords(mNodes.constData(), mNodes.size(), &Node::id);
+    }
+
+    PortSpan            portSpan(const NodeID &node) const override
+    {
+        int idx = index(node);
+        if (idx < 0)
+            return PortSpan::fromRecords<Port>(nullptr, 0, &Port::id);
+
+        auto &ports = mNodes[idx].ports;
+        return PortSpan::fromRecords(ports.constData(), ports.size(), &Port::id);
+    }
+
     PortIt              firstPort(const NodeID &node) const override
     {
         if (!node.isValid())
@@ -544,9 +582,46 @@ public:
             default:
                 break;
             }
+
+            notifyNodeDataChanged(node, role);
         }
     }
 
+    QPointF nodePosition(const NodeID &node) const override
+    {
+        int idx = index(node);
+        return idx >= 0 ? mNodes[idx].position : QPointF();
+    }
+
+    QSizeF nodeSize(const NodeID &node) const override
+    {
+        int idx = index(node);
+        return idx >= 0 ? mNodes[idx].size : QSizeF();
+    }
+
+    QString nodeCaption(const NodeID &node) const override
+    {
+        int idx = index(node);
+        return idx >= 0 ? mNodes[idx].name : QString();
+    }
+
+    void nodeRoleValues(const NodeID &node, RoleMask roles, RoleValues &values) const override
+    {
+        int idx = index(node);
+        if (idx < 0)
+            return;
+
+        auto &n = mNodes[idx];
+        if (roles & roleBit(DataRole::Display))
+            values.append({ DataRole::Display, n.name });
+        if (roles & roleBit(DataRole::Name))
+            values.append({ DataRole::Name, n.name });
+        if (roles & roleBit(DataRole::Position))
+            values.append({ DataRole::Position, n.position });
+        if (roles & roleBit(DataRole::Size))
+            values.append({ DataRole::Size, n.size });
+    }
+
     QVariant portData(const NodeID &node_id, const PortID &port_id, DataRole role) const override
     {
         int node_idx =  index(node_id);
@@ -604,7 +679,7 @@ public:
     NodeID createNode(NodeModel &model, const NodeTypeID &type, const QPointF &position, const NodeID &id) override
     {
         auto &tmodel = reinterpret_cast<TestModel&>(model);
-        auto node_id = id.isValid() ? id : tmodel.createNode("test");
+        auto node_id = tmodel.createNode("test", id);
         tmodel.setNodeData(node_id, position, DataRole::Position);
         tmodel.commitNode(node_id);
         return node_id;
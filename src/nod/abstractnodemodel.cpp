@@ -1,7 +1,15 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QHash>
+#include <QIODevice>
+#include <QSet>
+#include <QStringList>
+
+// ----------------------------------------------------------------------------
+
 #include "nod/abstractnodemodel.h"
+#include "nod/nodefactory.h"
 #include "nod/serialized.h"
 
 // ----------------------------------------------------------------------------
@@ -83,23 +91,48 @@ bool AbstractNodeModel::connect(const NodeID &node1, const PortID &port1,
 
     mConnections.push_back({ node1, port1, node2, port2 });
 
-    emit nodeConnected(*this, node1, port1);
-    emit nodeConnected(*this, node2, port2);
+    notifyConnected(mConnections.back());
 
     return true;
 }
 
 // ----------------------------------------------------------------------------
 
+int AbstractNodeModel::connectAll(const QVector<Connection> &connections)
+{
+    // hash the existing connections once instead of canConnect() per connection
+    QSet<Connection> seen;
+    seen.reserve(mConnections.size() + connections.size());
+    for (auto &c : mConnections)
+        seen.insert(c);
+
+    int count = 0;
+    mConnections.reserve(mConnections.size() + connections.size());
+    for (auto &c : connections)
+    {
+        if (!c.isValid() || seen.contains(c))
+            continue;
+
+        seen.insert(c);
+        mConnections.push_back(c);
+        notifyConnected(c);
+        ++count;
+    }
+
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+
 bool AbstractNodeModel::disconnect(const NodeID &node)
 {
     for (auto it=mConnections.begin(); it!=mConnections.end(); )
     {
         if (it->contains(node))
         {
-            emit portDisconnected(*this, it->node1, it->port1);
-            emit portDisconnected(*this, it->node2, it->port2);
+            auto c = *it;
             it = mConnections.erase(it);
+            notifyDisconnected(c);
         } else
             ++it;
     }
@@ -115,9 +148,9 @@ bool AbstractNodeModel::disconnect(const NodeID &node, const PortID &port)
     {
         if (it->contains(node, port))
         {
-            emit portDisconnected(*this, it->node1, it->port1);
-            emit portDisconnected(*this, it->node2, it->port2);
+            auto c = *it;
             mConnections.erase(it);
+            notifyDisconnected(c);
             return true;
         }
     }
@@ -164,19 +197,48 @@ bool AbstractNodeModel::isConnected(const Connection &connection) const
 
 // ----------------------------------------------------------------------------
 
+/// State shared while packing the nodes of one document.
+struct PackState
+{
+    QVector<Connection>         connections;
+    QSet<Connection>            seen;
+
+    bool                        compact = false;
+    QHash<QUuid, int>           ids;
+    QJsonArray                  id_table;
+};
+
+// ----------------------------------------------------------------------------
+
+static QJsonValue packID(PackState &state, const QUuid &id)
+{
+    if (!state.compact)
+        return id.toString();
+
+    auto it = state.ids.constFind(id);
+    if (it != state.ids.constEnd())
+        return *it;
+
+    int index = state.id_table.size();
+    state.ids.insert(id, index);
+    state.id_table.append(id.toString());
+    return index;
+}
+
+// ----------------------------------------------------------------------------
+
 static QJsonArray packPorts(Serialized &data,
                             AbstractNodeModel &model, const NodeID &node_id,
-                            QVector<Connection> &connections, Direction direction)
+                            PackState &state, Direction direction)
 {
     QJsonArray items;
-    for (auto pit=model.firstPort(node_id), end=model.endPort(node_id); pit!=end; pit.next())
+    for (auto &port_id : model.ports(node_id))
     {
-        if (model.portDirection(node_id, pit.port()) != direction)
+        if (model.portDirection(node_id, port_id) != direction)
             continue;
 
         QJsonObject prt;
-        auto port_id = pit.port();
-        prt["id"] = QString::fromLocal8Bit(port_id.value.toByteArray());
+        prt["id"] = packID(state, port_id.value);
 
         PortID other_port;
         auto other_node = model.connectedNode(node_id, port_id, &other_port);
@@ -188,21 +250,22 @@ static QJsonArray packPorts(Serialized &data,
             conn.node2 = other_node;
             conn.port2 = other_port;
 
-            if (!connections.contains(conn))
-                connections.append(conn);
+            if (!state.seen.contains(conn))
+            {
+                state.seen.insert(conn);
+                state.connections.append(conn);
+            }
         }
 
+        NodeModel::RoleValues values;
+        model.portRoleValues(node_id, port_id, NodeModel::rolesBelow(data.maxSerializedRole()), values);
+
         QJsonObject port_data;
-        for (int i=0; i<data.maxSerializedRole(); ++i)
+        for (auto &value : values)
         {
-            auto role = DataRole(i);
-            auto role_data = model.portData(node_id, port_id, role);
-            if (role_data.isNull())
-                continue;
-
-            auto name = model.roleName(role);
-            QString key = name ? QString::fromUtf8(name) : QString("%1").arg(i);
-            port_data[key] = Serialized::toJson(role_data);
+            auto name = model.roleName(value.role);
+            QString key = name ? QString::fromUtf8(name) : QString("%1").arg(int(value.role));
+            port_data[key] = Serialized::toJson(value.value);
         }
 
         prt["data"] = port_data;
@@ -217,21 +280,18 @@ static QJsonArray packPorts(Serialized &data,
 bool AbstractNodeModel::serialize(Serialized &data)
 {
     if (data.isReading())
-    {
-        data.isReading();
-    } else
-    {
-        auto it = firstNode();
-        return writeNodes(data, [this, &it] () -> NodeID {
-            if (it.atEnd())
-                return NodeID::invalid();
-            auto node = it.node();
-            it.next();
-            return node;
-        });
-    }
-
-    return true;
+        return readNodes(data);
+
+    auto range = nodes();
+    auto it = range.begin();
+    auto end = range.end();
+    return writeNodes(data, [&it, &end] () -> NodeID {
+        if (it == end)
+            return NodeID::invalid();
+        auto node = *it;
+        ++it;
+        return node;
+    });
 }
 
 // ----------------------------------------------------------------------------
@@ -248,13 +308,62 @@ bool AbstractNodeModel::writeNodes(Serialized &data, const QVector<NodeID> &node
 
 // ----------------------------------------------------------------------------
 
+static QJsonObject packNode(Serialized &data,
+                            AbstractNodeModel &model, const NodeID &node_id,
+                            PackState &state,
+                            NodeModel::RoleMask roles, NodeModel::RoleValues &values)
+{
+    QJsonObject node_obj;
+    node_obj["id"] = packID(state, node_id.value);
+
+    node_obj["in"] = packPorts(data, model, node_id, state, Direction::Input);
+
+    node_obj["out"] = packPorts(data, model, node_id, state, Direction::Output);
+
+    values.clear();
+    model.nodeRoleValues(node_id, roles, values);
+
+    QJsonObject node_data;
+    for (auto &value : values)
+    {
+        auto name = model.roleName(value.role);
+        QString key = name ? QString::fromUtf8(name) : QString("%1").arg(int(value.role));
+        node_data[key] = Serialized::toJson(value.value);
+    }
+
+    node_obj["data"] = node_data;
+
+    return node_obj;
+}
+
+// ----------------------------------------------------------------------------
+
+static QJsonObject packConnection(PackState &state, const Connection &c)
+{
+    QJsonObject obj;
+    obj["n1"] = packID(state, c.node1.value);
+    obj["p1"] = packID(state, c.port1.value);
+    obj["n2"] = packID(state, c.node2.value);
+    obj["p2"] = packID(state, c.port2.value);
+    return obj;
+}
+
+// ----------------------------------------------------------------------------
+
 bool AbstractNodeModel::writeNodes(Serialized &data, std::function<NodeID ()> next)
 {
-    QVector<Connection> connections;
+    if (data.device())
+        return streamNodes(data, next);
+
+    PackState state;
+    state.compact = data.compactIDs();
 
     QJsonObject root;
     root["version"] = SerializationVersion;
 
+    auto roles = rolesBelow(data.maxSerializedRole());
+    RoleValues values;
+
     QJsonArray nodes;
     while (true)
     {
@@ -262,52 +371,532 @@ bool AbstractNodeModel::writeNodes(Serialized &data, std::function<NodeID ()> ne
         if (!node_id.isValid())
             break;
 
-        QJsonObject node_obj;
-        node_obj["id"] = QString::fromLocal8Bit(node_id.value.toByteArray());
+        nodes.append(packNode(data, *this, node_id, state, roles, values));
+    }
 
-        node_obj["in"] = packPorts(data, *this, node_id, connections, Direction::Input);
+    root["nodes"] = nodes;
+
+    QJsonArray conn_array;
+    for (auto &c : state.connections)
+        conn_array.append(packConnection(state, c));
+
+    root["connections"] = conn_array;
 
-        node_obj["out"] = packPorts(data, *this, node_id, connections, Direction::Output);
+    if (state.compact)
+        root["ids"] = state.id_table;
+
+    data.doc().setObject(root);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool AbstractNodeModel::streamNodes(Serialized &data, std::function<NodeID ()> next)
+{
+    auto device = data.device();
 
-        QJsonObject node_data;
-        for (int i=0; i<data.maxSerializedRole(); ++i)
+    // same document as writeNodes(), written one node at a time
+    auto write = [device] (const QByteArray &bytes) -> bool {
+        return device->write(bytes) == bytes.size();
+    };
+
+    auto pack = [] (const QJsonObject &obj) -> QByteArray {
+        return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    };
+
+    PackState state;
+    state.compact = data.compactIDs();
+
+    auto roles = rolesBelow(data.maxSerializedRole());
+    RoleValues values;
+
+    if (!write("{\"version\":" + QByteArray::number(SerializationVersion) + ",\"nodes\":["))
+        return false;
+
+    bool first = true;
+    while (true)
+    {
+        auto node_id = next();
+        if (!node_id.isValid())
+            break;
+
+        if (!first && !write(","))
+            return false;
+
+        if (!write(pack(packNode(data, *this, node_id, state, roles, values))))
+            return false;
+
+        first = false;
+    }
+
+    if (!write("],\"connections\":["))
+        return false;
+
+    for (int i=0; i<state.connections.size(); ++i)
+    {
+        if (i > 0 && !write(","))
+            return false;
+
+        if (!write(pack(packConnection(state, state.connections[i]))))
+            return false;
+    }
+
+    // the table is complete only after all nodes and connections
+    if (state.compact)
+    {
+        if (!write("],\"ids\":"))
+            return false;
+
+        return write(QJsonDocument(state.id_table).toJson(QJsonDocument::Compact) + "}");
+    }
+
+    return write("]}");
+}
+
+// ----------------------------------------------------------------------------
+
+static QVariant unpackValue(DataRole role, const QJsonValue &value)
+{
+    switch (role)
+    {
+    case DataRole::Position:
+        return Serialized::toPointF(value);
+    case DataRole::Size:
+        return Serialized::toSizeF(value);
+    case DataRole::Type:
+        return QUuid(value.toString());
+    default:
+        break;
+    }
+
+    return value.toVariant();
+}
+
+// ----------------------------------------------------------------------------
+
+bool AbstractNodeModel::readNodes(Serialized &data)
+{
+    auto factory = data.nodeFactory();
+    if (!factory || !data.doc().isObject())
+        return false;
+
+    auto root = data.doc().object();
+    if (root["version"].toInt() > SerializationVersion)
+        return false;
+
+    // role keys as written by packNode()
+    QHash<QString, DataRole> roles;
+    for (int i=0; i<int(DataRole::User); ++i)
+    {
+        auto name = roleName(DataRole(i));
+        roles.insert(name ? QString::fromUtf8(name) : QString("%1").arg(i), DataRole(i));
+    }
+
+    auto unpackData = [&roles] (const QJsonObject &obj, RoleValues &values) {
+        values.clear();
+        for (auto it=obj.begin(); it!=obj.end(); ++it)
         {
-            auto role = DataRole(i);
-            auto role_data = nodeData(node_id, role);
-            if (role_data.isNull())
-                continue;
-
-            auto name = roleName(role);
-            QString key = name ? QString::fromUtf8(name) : QString("%1").arg(i);
-            node_data[key] = Serialized::toJson(role_data);
+            auto role = roles.constFind(it.key());
+            if (role != roles.constEnd())
+                values.append({ *role, unpackValue(*role, it.value()) });
         }
+    };
+
+    // compact documents store indexes into a single UUID table
+    QVector<QUuid> ids;
+    for (auto id : root["ids"].toArray())
+        ids.append(QUuid(id.toString()));
+
+    auto unpackID = [&ids] (const QJsonValue &value) -> QUuid {
+        if (!value.isDouble())
+            return QUuid(value.toString());
+
+        int index = value.toInt(-1);
+        return index >= 0 && index < ids.size() ? ids[index] : QUuid();
+    };
 
-        node_obj["data"] = node_data;
+    // stored UUIDs to created IDs
+    QHash<QUuid, NodeID> node_map;
+    QHash<QUuid, PortID> port_map;
+
+    QVector<PortID> created[2];
+    RoleValues values;
+
+    beginUpdate();
+
+    for (auto node_value : root["nodes"].toArray())
+    {
+        auto node_obj = node_value.toObject();
+        NodeID stored = { unpackID(node_obj["id"]), { 0 } };
 
-        nodes.append(node_obj);
+        unpackData(node_obj["data"].toObject(), values);
+
+        NodeTypeID type = NodeTypeID::invalid();
+        QPointF position;
+        for (auto &value : values)
+        {
+            if (value.role == DataRole::Type)
+                type.value = value.value.toUuid();
+            else
+            if (value.role == DataRole::Position)
+                position = value.value.toPointF();
+        }
+
+        auto node = factory->createNode(*this, type, position, data.newIDs() ? NodeID::invalid() : stored);
+        if (!node.isValid())
+            continue;
+
+        data.addReadNode(node);
+        node_map.insert(stored.value, node);
+
+        for (auto &value : values)
+        {
+            if (value.role != DataRole::Type && value.role != DataRole::Position)
+                setNodeData(node, value.value, value.role);
+        }
+
+        created[0].clear();
+        created[1].clear();
+        for (auto &port : ports(node))
+            created[portDirection(node, port) == Direction::Input ? 0 : 1].append(port);
+
+        const char *keys[2] = { "in", "out" };
+        for (int d=0; d<2; ++d)
+        {
+            auto port_array = node_obj[keys[d]].toArray();
+            for (int i=0; i<port_array.size() && i<created[d].size(); ++i)
+            {
+                auto port_obj = port_array[i].toObject();
+                auto &port = created[d][i];
+
+                port_map.insert(unpackID(port_obj["id"]), port);
+
+                unpackData(port_obj["data"].toObject(), values);
+                for (auto &value : values)
+                    setPortData(node, port, value.value, value.role);
+            }
+        }
+    }
+
+    QVector<Connection> connections;
+    for (auto conn_value : root["connections"].toArray())
+    {
+        auto obj = conn_value.toObject();
+
+        auto n1 = node_map.constFind(unpackID(obj["n1"]));
+        auto p1 = port_map.constFind(unpackID(obj["p1"]));
+        auto n2 = node_map.constFind(unpackID(obj["n2"]));
+        auto p2 = port_map.constFind(unpackID(obj["p2"]));
+        if (n1 == node_map.constEnd() || p1 == port_map.constEnd() ||
+            n2 == node_map.constEnd() || p2 == port_map.constEnd())
+            continue;
+
+        connections.append({ *n1, *p1, *n2, *p2 });
+    }
+
+    // checks duplicates against the existing connections in one pass
+    connectAll(connections);
+
+    endUpdate();
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::setJournaling(bool enable)
+{
+    mJournaling = enable;
+    checkpoint();
+}
+
+// ----------------------------------------------------------------------------
+
+bool AbstractNodeModel::hasJournalChanges() const
+{
+    return !mJournalNodeIndex.isEmpty() || !mJournalDeleted.isEmpty() ||
+           !mJournalConnected.isEmpty() || !mJournalDisconnected.isEmpty();
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::checkpoint()
+{
+    mJournalNodes.clear();
+    mJournalNodeIndex.clear();
+    mJournalCreated.clear();
+    mJournalDeleted.clear();
+    mJournalConnected.clear();
+    mJournalDisconnected.clear();
+}
+
+// ----------------------------------------------------------------------------
+
+bool AbstractNodeModel::writeDelta(Serialized &data)
+{
+    // folding matches IDs by UUID, never write the compact form
+    PackState state;
+
+    auto roles = rolesBelow(data.maxSerializedRole());
+    RoleValues values;
+
+    QJsonObject root;
+    root["version"] = SerializationVersion;
+    root["delta"] = true;
+
+    QJsonArray nodes;
+    for (auto &node : mJournalNodes)
+    {
+        if (node.isValid())
+            nodes.append(packNode(data, *this, node, state, roles, values));
     }
 
     root["nodes"] = nodes;
 
-    QJsonArray conn_array;
-    for (auto c : connections)
+    QJsonArray deleted;
+    for (auto &id : mJournalDeleted.items)
     {
-        QJsonObject obj;
-        obj["n1"] = QString::fromLocal8Bit(c.node1.value.toByteArray());
-        obj["p1"] = QString::fromLocal8Bit(c.port1.value.toByteArray());
-        obj["n2"] = QString::fromLocal8Bit(c.node2.value.toByteArray());
-        obj["p2"] = QString::fromLocal8Bit(c.port2.value.toByteArray());
-        conn_array.append(obj);
+        if (!id.isNull())
+            deleted.append(id.toString());
     }
 
-    root["connections"] = conn_array;
+    root["deleted"] = deleted;
 
-    data.doc().setObject(root);
+    QJsonArray connected;
+    for (auto &c : mJournalConnected.items)
+    {
+        if (c.isValid())
+            connected.append(packConnection(state, c));
+    }
+
+    root["connections"] = connected;
+
+    QJsonArray disconnected;
+    for (auto &c : mJournalDisconnected.items)
+    {
+        if (c.isValid())
+            disconnected.append(packConnection(state, c));
+    }
+
+    root["disconnected"] = disconnected;
+
+    if (data.device())
+    {
+        auto bytes = QJsonDocument(root).toJson(QJsonDocument::Compact) + '\n';
+        if (data.device()->write(bytes) != bytes.size())
+            return false;
+    } else
+        data.doc().setObject(root);
+
+    checkpoint();
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool AbstractNodeModel::foldDelta(QJsonObject &snapshot, const QJsonObject &delta)
+{
+    if (snapshot.contains("ids") || !delta["delta"].toBool())
+        return false;
+
+    QSet<QString> deleted;
+    for (auto id : delta["deleted"].toArray())
+        deleted.insert(id.toString());
+
+    // changed nodes replace stored ones in place, new ones are appended
+    QHash<QString, QJsonObject> changed;
+    QStringList added;
+    for (auto node : delta["nodes"].toArray())
+    {
+        auto obj = node.toObject();
+        auto id = obj["id"].toString();
+        changed.insert(id, obj);
+        added.append(id);
+    }
+
+    QJsonArray nodes;
+    for (auto node : snapshot["nodes"].toArray())
+    {
+        auto id = node.toObject()["id"].toString();
+        if (deleted.contains(id))
+            continue;
+
+        auto it = changed.find(id);
+        if (it != changed.end())
+        {
+            nodes.append(*it);
+            changed.erase(it);
+        } else
+            nodes.append(node);
+    }
+
+    for (auto &id : added)
+    {
+        auto it = changed.constFind(id);
+        if (it != changed.constEnd())
+            nodes.append(*it);
+    }
+
+    auto connectionKey = [] (const QJsonObject &c) -> QString {
+        auto p1 = c["p1"].toString();
+        auto p2 = c["p2"].toString();
+        return p1 < p2 ? p1 + p2 : p2 + p1;
+    };
+
+    QSet<QString> removed;
+    for (auto c : delta["disconnected"].toArray())
+        removed.insert(connectionKey(c.toObject()));
+
+    QSet<QString> present;
+    QJsonArray connections;
+    auto addConnection = [&] (const QJsonValue &value) {
+        auto c = value.toObject();
+        auto key = connectionKey(c);
+        if (removed.contains(key) || present.contains(key) ||
+            deleted.contains(c["n1"].toString()) || deleted.contains(c["n2"].toString()))
+            return;
+
+        present.insert(key);
+        connections.append(c);
+    };
+
+    for (auto c : snapshot["connections"].toArray())
+        addConnection(c);
+
+    // a connection may be removed and made again between checkpoints
+    removed.clear();
+    for (auto c : delta["connections"].toArray())
+        addConnection(c);
+
+    snapshot["nodes"] = nodes;
+    snapshot["connections"] = connections;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+template <typename T>
+void AbstractNodeModel::OrderedSet<T>::insert(const T &item)
+{
+    if (index.contains(item))
+        return;
+
+    index.insert(item, items.size());
+    items.append(item);
+}
+
+// ----------------------------------------------------------------------------
+
+template <typename T>
+bool AbstractNodeModel::OrderedSet<T>::remove(const T &item)
+{
+    auto it = index.find(item);
+    if (it == index.end())
+        return false;
+
+    items[*it] = T();
+    index.erase(it);
     return true;
 }
 
 // ----------------------------------------------------------------------------
 
+void AbstractNodeModel::journalNode(const NodeID &node)
+{
+    // first change decides the order, keeps deltas deterministic
+    if (mJournalNodeIndex.contains(node.value))
+        return;
+
+    mJournalNodeIndex.insert(node.value, mJournalNodes.size());
+    mJournalNodes.append(node);
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::notifyNodeCreated(const NodeID &node)
+{
+    if (mJournaling)
+    {
+        mJournalCreated.insert(node.value);
+        mJournalDeleted.remove(node.value);
+        journalNode(node);
+    }
+
+    NodeModel::notifyNodeCreated(node);
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::notifyNodeDeleted(const NodeID &node)
+{
+    if (mJournaling)
+    {
+        auto it = mJournalNodeIndex.find(node.value);
+        if (it != mJournalNodeIndex.end())
+        {
+            mJournalNodes[*it] = NodeID::invalid();
+            mJournalNodeIndex.erase(it);
+        }
+
+        if (!mJournalCreated.remove(node.value))
+            mJournalDeleted.insert(node.value);
+    }
+
+    NodeModel::notifyNodeDeleted(node);
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::notifyConnected(const Connection &connection)
+{
+    if (mJournaling && !mJournalDisconnected.remove(connection))
+        mJournalConnected.insert(connection);
+
+    NodeModel::notifyConnected(connection);
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::notifyDisconnected(const Connection &connection)
+{
+    if (mJournaling && !mJournalConnected.remove(connection))
+        mJournalDisconnected.insert(connection);
+
+    NodeModel::notifyDisconnected(connection);
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::notifyPortsChanged(const NodeID &node)
+{
+    if (mJournaling)
+        journalNode(node);
+
+    NodeModel::notifyPortsChanged(node);
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::notifyNodeDataChanged(const NodeID &node, DataRole role)
+{
+    if (mJournaling)
+        journalNode(node);
+
+    NodeModel::notifyNodeDataChanged(node, role);
+}
+
+// ----------------------------------------------------------------------------
+
+void AbstractNodeModel::notifyPortDataChanged(const NodeID &node, const PortID &port, DataRole role)
+{
+    if (mJournaling)
+        journalNode(node);
+
+    NodeModel::notifyPortDataChanged(node, port, role);
+}
+
+// ----------------------------------------------------------------------------
+
 } // namespace nod
 
 // ----------------------------------------------------------------------------
@@ -6,6 +6,9 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QHash>
+#include <QJsonObject>
+#include <QSet>
 #include <QVector>
 
 // ----------------------------------------------------------------------------
@@ -30,10 +33,64 @@ public:
 
     using NodeModel::NodeModel;
 
+    /** Writes the nodes returned by @a next until it returns an invalid ID.
+     *
+     * Streams to Serialized::device() if set, otherwise fills Serialized::doc().
+     *
+     */
     bool                        writeNodes(Serialized &data, std::function<NodeID ()> next);
 
+    /* Journal */
+
+    /** Enables recording changes for writeDelta(), starts a checkpoint.
+     *
+     * Disabled by default. Changes are recorded from the notify functions,
+     * which are final here so the journal sees every notification. Models
+     * must notify all node and port data changes, including the ones made
+     * through setNodeData() and setPortData().
+     *
+     */
+    void                        setJournaling(bool enable=true);
+
+    bool                        isJournaling() const { return mJournaling; }
+
+    /// True if changes were recorded since the last checkpoint.
+    bool                        hasJournalChanges() const;
+
+    /// Drops the recorded changes, usually after a full save.
+    void                        checkpoint();
+
+    /** Writes the changes since the last checkpoint and starts a new one.
+     *
+     * The delta lists changed nodes in full, deleted node IDs and made or
+     * removed connections, each in the order of their first change so equal
+     * journals write equal deltas. With Serialized::device() set the delta is
+     * appended as a single line, so a log of deltas can be kept next to a
+     * snapshot. IDs are always written as UUIDs.
+     *
+     */
+    bool                        writeDelta(Serialized &data);
+
+    /** Folds a delta written by writeDelta() into a snapshot document.
+     *
+     * Applying the deltas of a log in order yields the nodes and connections
+     * a full save would have written, connections removed and made again
+     * keep their old place. Compact snapshots can't be folded into.
+     *
+     */
+    static bool                 foldDelta(QJsonObject &snapshot, const QJsonObject &delta);
+
     /* NodeModel */
 
+    /** Writes all nodes, or reads nodes written by writeNodes().
+     *
+     * Reading requires Serialized::nodeFactory(), nodes are created with
+     * their stored IDs and stored ports are matched to the created ports
+     * by direction and order.
+     *
+     */
+    bool                        serialize(Serialized &data) override;
+
     NodeID                      connectedNode(const NodeID &node, const PortID &port, PortID *other_port=nullptr) const override;
 
     PortID                      connectedPort(const NodeID &node, const PortID &port) const override;
@@ -46,6 +103,9 @@ public:
     bool                        connect(const NodeID &node1, const PortID &port1,
                                         const NodeID &node2, const PortID &port2) override;
 
+    /// Only checks for duplicates, the connections are trusted otherwise.
+    int                         connectAll(const QVector<Connection> &connections) override;
+
     bool                        disconnect(const NodeID &node) override;
 
     bool                        disconnect(const NodeID &node, const PortID &port) override;
@@ -56,13 +116,60 @@ public:
 
     bool                        isConnected(const Connection &connection) const override;
 
-    bool                        serialize(Serialized &data) override;
-
     bool                        writeNodes(Serialized &data, const QVector<NodeID> &nodes) override;
 
+protected:
+
+    /* The journal records changes here, sealed so it can't be bypassed.
+     * Subclasses observe changes through the NodeModel signals. */
+
+    void                        notifyNodeCreated(const NodeID &node) final;
+
+    void                        notifyNodeDeleted(const NodeID &node) final;
+
+    void                        notifyConnected(const Connection &connection) final;
+
+    void                        notifyDisconnected(const Connection &connection) final;
+
+    void                        notifyPortsChanged(const NodeID &node) final;
+
+    void                        notifyNodeDataChanged(const NodeID &node, DataRole role) final;
+
+    void                        notifyPortDataChanged(const NodeID &node, const PortID &port, DataRole role) final;
+
 private:
 
+    /// Set keeping the insertion order, removed items leave a T() hole.
+    template <typename T>
+    struct OrderedSet
+    {
+        QVector<T>              items;
+        QHash<T, int>           index;      // in items
+
+        bool                    isEmpty() const { return index.isEmpty(); }
+
+        void                    insert(const T &item);
+
+        bool                    remove(const T &item);
+
+        void                    clear() { items.clear(); index.clear(); }
+    };
+
     QVector<Connection>         mConnections;
+
+    bool                        mJournaling = false;
+    QVector<NodeID>             mJournalNodes;      // created or changed, in order, invalid if deleted
+    QHash<QUuid, int>           mJournalNodeIndex;  // index in mJournalNodes
+    QSet<QUuid>                 mJournalCreated;
+    OrderedSet<QUuid>           mJournalDeleted;
+    OrderedSet<Connection>      mJournalConnected;
+    OrderedSet<Connection>      mJournalDisconnected;
+
+    void                        journalNode(const NodeID &node);
+
+    bool                        streamNodes(Serialized &data, std::function<NodeID ()> next);
+
+    bool                        readNodes(Serialized &data);
 };
 
 // ----------------------------------------------------------------------------
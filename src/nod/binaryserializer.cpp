@@ -0,0 +1,572 @@
+
+// ----------------------------------------------------------------------------
+
+#include <QBuffer>
+#include <QIODevice>
+#include <QRectF>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/binaryserializer.h"
+#include "nod/nodefactory.h"
+
+// ----------------------------------------------------------------------------
+
+namespace nod {
+
+// ----------------------------------------------------------------------------
+
+static const QDataStream::Version StreamVersion = QDataStream::Qt_5_6;
+
+// ----------------------------------------------------------------------------
+
+BinarySerializer::BinarySerializer(NodeModel &model)
+    : mModel(model)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+bool BinarySerializer::write(QIODevice &device)
+{
+    auto range = mModel.nodes();
+    auto it = range.begin();
+    auto end = range.end();
+    return write(device, [&it, &end] () -> NodeID {
+        if (it == end)
+            return NodeID::invalid();
+        auto node = *it;
+        ++it;
+        return node;
+    });
+}
+
+// ----------------------------------------------------------------------------
+
+bool BinarySerializer::write(QIODevice &device, const QVector<NodeID> &nodes)
+{
+    int at = 0;
+    return write(device, [&at, &nodes] () -> NodeID {
+        if (at < nodes.size())
+            return nodes[at++];
+        return NodeID::invalid();
+    });
+}
+
+// ----------------------------------------------------------------------------
+
+bool BinarySerializer::write(QIODevice &device, std::function<NodeID ()> next)
+{
+    struct PortRef
+    {
+        quint32                 node;
+        quint16                 port;
+    };
+
+    struct ConnectionRef
+    {
+        PortRef                 a, b;
+    };
+
+    mStringIndex.clear();
+    mStrings.clear();
+
+    // nodes go to a buffer first, the string table is written before them
+    QByteArray body;
+    QBuffer buffer(&body);
+    buffer.open(QIODevice::WriteOnly);
+
+    QDataStream stream(&buffer);
+    stream.setVersion(StreamVersion);
+
+    auto roles = NodeModel::rolesBelow(mMaxSerializedRole);
+    NodeModel::RoleValues values;
+
+    QHash<QUuid, PortRef> ports;
+    QVector<ConnectionRef> connections;
+    QVector<PortID> node_ports;
+    quint32 node_count = 0;
+
+    while (true)
+    {
+        auto node = next();
+        if (!node.isValid())
+            break;
+
+        writeUuid(stream, node.value);
+
+        values.clear();
+        mModel.nodeRoleValues(node, roles, values);
+        writeRoles(stream, values);
+
+        node_ports.clear();
+        for (auto &port : mModel.ports(node))
+            node_ports.append(port);
+
+        stream << quint16(node_ports.size());
+        for (int i=0; i<node_ports.size(); ++i)
+        {
+            auto &port = node_ports[i];
+            PortRef ref = { node_count, quint16(i) };
+
+            writeUuid(stream, port.value);
+            stream << quint8(mModel.portDirection(node, port));
+
+            values.clear();
+            mModel.portRoleValues(node, port, roles, values);
+            writeRoles(stream, values);
+
+            ports.insert(port.value, ref);
+
+            // emitted once both ends were written, skips nodes not written
+            PortID other_port;
+            auto other_node = mModel.connectedNode(node, port, &other_port);
+            if (other_node.isValid())
+            {
+                auto other = ports.constFind(other_port.value);
+                if (other != ports.constEnd() && other_port.value != port.value)
+                    connections.append({ *other, ref });
+            }
+        }
+
+        ++node_count;
+    }
+
+    stream << quint32(connections.size());
+    for (auto &c : connections)
+        stream << c.a.node << c.a.port << c.b.node << c.b.port;
+
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    buffer.close();
+
+    QDataStream out(&device);
+    out.setVersion(StreamVersion);
+    out << quint32(Magic) << quint16(Version);
+
+    out << quint32(mStrings.size());
+    for (auto &str : mStrings)
+        out << str;
+
+    out << node_count;
+    if (out.writeRawData(body.constData(), body.size()) != body.size())
+        return false;
+
+    return out.status() == QDataStream::Ok;
+}
+
+// ----------------------------------------------------------------------------
+
+bool BinarySerializer::read(QIODevice &device, NodeFactory &factory, bool new_ids)
+{
+    struct PortRecord
+    {
+        quint8                  direction;
+        NodeModel::RoleValues   values;
+    };
+
+    struct NodeRecord
+    {
+        QUuid                   uuid;
+        NodeModel::RoleValues   values;
+        QVector<PortRecord>     ports;
+    };
+
+    struct ConnectionRecord
+    {
+        quint32                 n1, n2;
+        quint16                 p1, p2;
+    };
+
+    mReadNodes.clear();
+
+    QDataStream stream(&device);
+    stream.setVersion(StreamVersion);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if (magic != quint32(Magic) || version > Version)
+        return false;
+
+    quint32 string_count = 0;
+    stream >> string_count;
+
+    mStrings.clear();
+    for (quint32 i=0; i<string_count && stream.status() == QDataStream::Ok; ++i)
+    {
+        QString str;
+        stream >> str;
+        mStrings.append(str);
+    }
+
+    quint32 node_count = 0;
+    stream >> node_count;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    // the whole stream is decoded before the model is touched, a corrupt
+    // stream leaves the model unchanged
+    QVector<NodeRecord> nodes;
+    for (quint32 n=0; n<node_count; ++n)
+    {
+        NodeRecord node;
+        node.uuid = readUuid(stream);
+        if (!readRoles(stream, node.values))
+            return false;
+
+        quint16 port_count = 0;
+        stream >> port_count;
+
+        node.ports.resize(port_count);
+        for (auto &port : node.ports)
+        {
+            readUuid(stream);
+            stream >> port.direction;
+            if (!readRoles(stream, port.values) || port.direction > 1)
+                return false;
+        }
+
+        nodes.append(node);
+    }
+
+    quint32 connection_count = 0;
+    stream >> connection_count;
+
+    QVector<ConnectionRecord> connection_records;
+    for (quint32 i=0; i<connection_count && stream.status() == QDataStream::Ok; ++i)
+    {
+        ConnectionRecord c;
+        stream >> c.n1 >> c.p1 >> c.n2 >> c.p2;
+        connection_records.append(c);
+    }
+
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    // created nodes and ports in stored order, invalid if not created
+    QVector<NodeID> node_ids;
+    QVector<QVector<PortID>> node_ports;
+    QVector<PortID> created[2];
+
+    mModel.beginUpdate();
+
+    for (auto &record : nodes)
+    {
+        NodeTypeID type = NodeTypeID::invalid();
+        QPointF position;
+        for (auto &value : record.values)
+        {
+            if (value.role == DataRole::Type)
+                type.value = value.value.toUuid();
+            else
+            if (value.role == DataRole::Position)
+                position = value.value.toPointF();
+        }
+
+        NodeID id = { new_ids ? QUuid() : record.uuid, { 0 } };
+        auto node = factory.createNode(mModel, type, position, id);
+        node_ids.append(node);
+
+        created[0].clear();
+        created[1].clear();
+        if (node.isValid())
+        {
+            mReadNodes.append(node);
+
+            for (auto &value : record.values)
+            {
+                if (value.role != DataRole::Type)
+                    mModel.setNodeData(node, value.value, value.role);
+            }
+
+            for (auto &port : mModel.ports(node))
+                created[mModel.portDirection(node, port) == Direction::Input ? 0 : 1].append(port);
+        }
+
+        node_ports.append(QVector<PortID>());
+        auto &ports = node_ports.last();
+
+        int counts[2] = { 0, 0 };
+        for (auto &port_record : record.ports)
+        {
+            int direction = port_record.direction == quint8(Direction::Input) ? 0 : 1;
+            int index = counts[direction]++;
+
+            auto port = index < created[direction].size() ? created[direction][index] : PortID::invalid();
+            ports.append(port);
+
+            if (!port.isValid())
+                continue;
+
+            for (auto &value : port_record.values)
+                mModel.setPortData(node, port, value.value, value.role);
+        }
+    }
+
+    QVector<Connection> connections;
+    connections.reserve(connection_records.size());
+    for (auto &c : connection_records)
+    {
+        if (c.n1 < quint32(node_ports.size()) && c.n2 < quint32(node_ports.size()) &&
+            c.p1 < node_ports[c.n1].size() && c.p2 < node_ports[c.n2].size() &&
+            node_ports[c.n1][c.p1].isValid() && node_ports[c.n2][c.p2].isValid())
+        {
+            connections.append({ node_ids[c.n1], node_ports[c.n1][c.p1], node_ids[c.n2], node_ports[c.n2][c.p2] });
+        }
+    }
+
+    mModel.connectAll(connections);
+
+    mModel.endUpdate();
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void BinarySerializer::writeRoles(QDataStream &stream, const NodeModel::RoleValues &values)
+{
+    stream << quint8(values.size());
+    for (auto &value : values)
+    {
+        stream << quint8(value.role);
+        writeValue(stream, value.value);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void BinarySerializer::writeValue(QDataStream &stream, const QVariant &value)
+{
+    switch (value.userType())
+    {
+    case QMetaType::QString:
+        {
+            auto str = value.toString();
+            auto it = mStringIndex.constFind(str);
+            if (it == mStringIndex.constEnd())
+            {
+                it = mStringIndex.insert(str, quint32(mStrings.size()));
+                mStrings.append(str);
+            }
+
+            stream << quint8(ValueType::String) << *it;
+        }
+        break;
+    case QMetaType::Double:
+        stream << quint8(ValueType::Double) << value.toDouble();
+        break;
+    case QMetaType::Float:
+        stream << quint8(ValueType::Float) << value.toFloat();
+        break;
+    case QMetaType::Int:
+        stream << quint8(ValueType::Int32) << qint32(value.toInt());
+        break;
+    case QMetaType::UInt:
+        stream << quint8(ValueType::UInt32) << quint32(value.toUInt());
+        break;
+    case QMetaType::LongLong:
+        stream << quint8(ValueType::Int) << value.toLongLong();
+        break;
+    case QMetaType::ULongLong:
+        stream << quint8(ValueType::UInt64) << value.toULongLong();
+        break;
+    case QMetaType::Bool:
+        stream << quint8(ValueType::Bool) << value.toBool();
+        break;
+    case QMetaType::QPoint:
+        stream << quint8(ValueType::PointI) << value.toPoint();
+        break;
+    case QMetaType::QPointF:
+        stream << quint8(ValueType::Point) << value.toPointF();
+        break;
+    case QMetaType::QSize:
+        stream << quint8(ValueType::SizeI) << value.toSize();
+        break;
+    case QMetaType::QSizeF:
+        stream << quint8(ValueType::Size) << value.toSizeF();
+        break;
+    case QMetaType::QRect:
+        stream << quint8(ValueType::RectI) << value.toRect();
+        break;
+    case QMetaType::QRectF:
+        stream << quint8(ValueType::Rect) << value.toRectF();
+        break;
+    case QMetaType::QUuid:
+        stream << quint8(ValueType::Uuid);
+        writeUuid(stream, value.toUuid());
+        break;
+    default:
+        if (value.isNull())
+            stream << quint8(ValueType::Null);
+        else
+            stream << quint8(ValueType::Variant) << value;
+        break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+bool BinarySerializer::readRoles(QDataStream &stream, NodeModel::RoleValues &values)
+{
+    quint8 count = 0;
+    stream >> count;
+
+    for (int i=0; i<count; ++i)
+    {
+        quint8 role = 0;
+        stream >> role;
+
+        auto value = readValue(stream);
+        if (stream.status() != QDataStream::Ok)
+            return false;
+
+        values.append({ DataRole(role), value });
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+// ----------------------------------------------------------------------------
+
+QVariant BinarySerializer::readValue(QDataStream &stream)
+{
+    quint8 type = 0;
+    stream >> type;
+
+    switch (ValueType(type))
+    {
+    case ValueType::Null:
+        return QVariant();
+    case ValueType::String:
+        {
+            quint32 index = 0;
+            stream >> index;
+            if (index >= quint32(mStrings.size()))
+            {
+                stream.setStatus(QDataStream::ReadCorruptData);
+                return QVariant();
+            }
+            return mStrings[int(index)];
+        }
+    case ValueType::Double:
+        {
+            double value = 0;
+            stream >> value;
+            return value;
+        }
+    case ValueType::Int:
+        {
+            qint64 value = 0;
+            stream >> value;
+            return value;
+        }
+    case ValueType::Bool:
+        {
+            bool value = false;
+            stream >> value;
+            return value;
+        }
+    case ValueType::Point:
+        {
+            QPointF value;
+            stream >> value;
+            return value;
+        }
+    case ValueType::Size:
+        {
+            QSizeF value;
+            stream >> value;
+            return value;
+        }
+    case ValueType::Rect:
+        {
+            QRectF value;
+            stream >> value;
+            return value;
+        }
+    case ValueType::Uuid:
+        return readUuid(stream);
+    case ValueType::Float:
+        {
+            float value = 0;
+            stream >> value;
+            return value;
+        }
+    case ValueType::Int32:
+        {
+            qint32 value = 0;
+            stream >> value;
+            return int(value);
+        }
+    case ValueType::UInt32:
+        {
+            quint32 value = 0;
+            stream >> value;
+            return uint(value);
+        }
+    case ValueType::UInt64:
+        {
+            quint64 value = 0;
+            stream >> value;
+            return qulonglong(value);
+        }
+    case ValueType::PointI:
+        {
+            QPoint value;
+            stream >> value;
+            return value;
+        }
+    case ValueType::SizeI:
+        {
+            QSize value;
+            stream >> value;
+            return value;
+        }
+    case ValueType::RectI:
+        {
+            QRect value;
+            stream >> value;
+            return value;
+        }
+    case ValueType::Variant:
+        {
+            QVariant value;
+            stream >> value;
+            return value;
+        }
+    }
+
+    stream.setStatus(QDataStream::ReadCorruptData);
+    return QVariant();
+}
+
+// ----------------------------------------------------------------------------
+
+void BinarySerializer::writeUuid(QDataStream &stream, const QUuid &uuid)
+{
+    auto bytes = uuid.toRfc4122();
+    stream.writeRawData(bytes.constData(), bytes.size());
+}
+
+// ----------------------------------------------------------------------------
+
+QUuid BinarySerializer::readUuid(QDataStream &stream)
+{
+    char bytes[16];
+    if (stream.readRawData(bytes, sizeof(bytes)) != int(sizeof(bytes)))
+    {
+        stream.setStatus(QDataStream::ReadPastEnd);
+        return QUuid();
+    }
+
+    return QUuid::fromRfc4122(QByteArray::fromRawData(bytes, sizeof(bytes)));
+}
+
+// ----------------------------------------------------------------------------
+
+} // namespace nod
+
+// ----------------------------------------------------------------------------
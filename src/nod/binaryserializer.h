@@ -0,0 +1,138 @@
+
+// ----------------------------------------------------------------------------
+
+#ifndef NOD_BINARYSERIALIZER_H
+#define NOD_BINARYSERIALIZER_H
+
+// ----------------------------------------------------------------------------
+
+#include <functional>
+
+// ----------------------------------------------------------------------------
+
+#include <QDataStream>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/nodemodel.h"
+
+// ----------------------------------------------------------------------------
+
+class QIODevice;
+
+// ----------------------------------------------------------------------------
+
+namespace nod {
+
+// ----------------------------------------------------------------------------
+
+/** Reads and writes models in a compact binary format.
+ *
+ * Layout, all integers in QDataStream byte order:
+ *  * header: magic, version
+ *  * string table: all string role values, referenced by index
+ *  * nodes: raw 16 byte UUID, typed role values, ports with UUID, direction and roles
+ *  * role values keep their variant type, an Int role is read back as Int
+ *  * connections: node and port by dense index into the nodes written before
+ *
+ * Reading creates the nodes through a NodeFactory inside a single model
+ * update. Ports are matched to the ports the factory created by direction
+ * and index. The stream is decoded completely before the model is changed,
+ * so a corrupt stream doesn't leave a partially read model behind.
+ *
+ */
+class BinarySerializer
+{
+public:
+
+    enum
+    {
+        Magic                   = 0x4e4f4442,   // "NODB"
+        Version                 = 2
+    };
+
+    BinarySerializer(NodeModel &model);
+
+    void                        setMaxSerializedRole(int max) { mMaxSerializedRole = max; }
+
+    int                         maxSerializedRole() const { return mMaxSerializedRole; }
+
+    /// Writes all nodes of the model.
+    bool                        write(QIODevice &device);
+
+    /// Writes the given nodes and the connections between them.
+    bool                        write(QIODevice &device, const QVector<NodeID> &nodes);
+
+    /** Reads nodes into the model.
+     *
+     * The model is left unchanged if false is returned.
+     *
+     * @param device The device to read from.
+     * @param factory Creates the nodes and their ports.
+     * @param new_ids Creates new node IDs instead of restoring the stored ones.
+     *
+     */
+    bool                        read(QIODevice &device, NodeFactory &factory, bool new_ids=false);
+
+    /// IDs of the nodes created by the last read().
+    const QVector<NodeID>       &readNodes() const { return mReadNodes; }
+
+private:
+
+    enum class ValueType : quint8
+    {
+        Null,
+        String,
+        Double,
+        Int,        // qint64
+        Bool,
+        Point,      // QPointF
+        Size,       // QSizeF
+        Rect,       // QRectF
+        Uuid,
+        Variant,
+
+        // version 2
+        Float,
+        Int32,
+        UInt32,
+        UInt64,
+        PointI,
+        SizeI,
+        RectI
+    };
+
+    NodeModel                   &mModel;
+    int                         mMaxSerializedRole = int(DataRole::MaxSerializedRole);
+
+    QHash<QString, quint32>     mStringIndex;
+    QStringList                 mStrings;
+    QVector<NodeID>             mReadNodes;
+
+    bool                        write(QIODevice &device, std::function<NodeID ()> next);
+
+    void                        writeRoles(QDataStream &stream, const NodeModel::RoleValues &values);
+
+    void                        writeValue(QDataStream &stream, const QVariant &value);
+
+    bool                        readRoles(QDataStream &stream, NodeModel::RoleValues &values);
+
+    QVariant                    readValue(QDataStream &stream);
+
+    static void                 writeUuid(QDataStream &stream, const QUuid &uuid);
+
+    static QUuid                readUuid(QDataStream &stream);
+};
+
+// ----------------------------------------------------------------------------
+
+} // namespace nod
+
+// ----------------------------------------------------------------------------
+
+#endif // NOD_BINARYSERIALIZER_H
+
+// ----------------------------------------------------------------------------
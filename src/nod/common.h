@@ -163,6 +163,14 @@ inline bool operator==(const Connection &a, const Connection &b)
 
 // ----------------------------------------------------------------------------
 
+/// Symmetric like Connection::isEqual(), both directions hash the same.
+inline uint qHash(const Connection &c, uint seed=0)
+{
+    return qHash(c.port1.value, seed) ^ qHash(c.port2.value, seed);
+}
+
+// ----------------------------------------------------------------------------
+
 class NodeFactory;
 class NodeModel;
 class Serialized;
@@ -184,6 +192,16 @@ struct ItemZ
 
 // ----------------------------------------------------------------------------
 
+/// Level of detail items are drawn with, depends on the view zoom.
+enum class DetailLevel
+{
+    Low,                // flat shapes, no text, no ports
+    Medium,             // full shapes, no text
+    Full
+};
+
+// ----------------------------------------------------------------------------
+
 Q_NAMESPACE
 
 // ----------------------------------------------------------------------------
@@ -52,6 +52,7 @@ void ConnectionItem::updatePath()
     auto c1 = mScene.grid().snapAt(item1->mapToScene(item1->portRect(item1->boundingRect(), mConnection.port1).center()));
     auto c2 = mScene.grid().snapAt(item2->mapToScene(item2->portRect(item2->boundingRect(), mConnection.port2).center()));
 
+    prepareGeometryChange();
     mShape->updatePath(c1, c2);
 
     /*
@@ -75,6 +76,9 @@ void ConnectionItem::updateGrid()
 
 QRectF ConnectionItem::boundingRect() const
 {
+    if (!mShape)
+        return QRectF();
+
     auto rc = mShape->boundingRect();
     //rc.moveTopLeft(rc.topLeft());
     //rc.moveTopLeft(QPointF(40, 0));
@@ -83,9 +87,35 @@ QRectF ConnectionItem::boundingRect() const
 
 // ----------------------------------------------------------------------------
 
+QPainterPath ConnectionItem::shape() const
+{
+    if (!mShape)
+        return QPainterPath();
+
+    return mShape->shape();
+}
+
+// ----------------------------------------------------------------------------
+
+bool ConnectionItem::contains(const QPointF &point) const
+{
+    if (!mShape || !mShape->boundingRect().contains(point))
+        return false;
+
+    return mShape->shape().contains(point);
+}
+
+// ----------------------------------------------------------------------------
+
 void ConnectionItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
 {
-    if (mShape)
+    if (!mShape)
+        return;
+
+    auto lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    if (mScene.detailLevel(lod) == DetailLevel::Low)
+        mShape->drawLowDetail(*painter);
+    else
         mShape->draw(*painter);
 }
 
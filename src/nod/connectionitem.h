@@ -39,6 +39,10 @@ public:
 
     QRectF                      boundingRect() const override;
 
+    QPainterPath                shape() const override;
+
+    bool                        contains(const QPointF &point) const override;
+
     void                        paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
 
 private:
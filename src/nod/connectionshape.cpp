@@ -1,6 +1,10 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QPainter>
+
+// ----------------------------------------------------------------------------
+
 #include "nod/nodegrid.h"
 
 // ----------------------------------------------------------------------------
@@ -33,7 +37,7 @@ void ConnectionShape::updatePath(const QPointF &start, const QPointF &end)
     // TODO: use A* planner
 #if 1
     mPath.clear();
-    mGrid.planner().plan(mPath, start, end, [] (const GridCell &cell) -> int {
+    mGrid.planner().plan(mPlanState, mPath, start, end, [] (const GridCell &cell) -> int {
         return 0;
     });
 #else
@@ -42,11 +46,36 @@ void ConnectionShape::updatePath(const QPointF &start, const QPointF &end)
     mPath.push_back(end);
 #endif
 
+    ++mVersion;
     updateShape();
 }
 
 // ----------------------------------------------------------------------------
 
+void ConnectionShape::setStraightPath(const QPointF &start, const QPointF &end)
+{
+    mPath.clear();
+    mPath.push_back(start);
+    mPath.push_back(end);
+
+    ++mVersion;
+    updateShape();
+}
+
+// ----------------------------------------------------------------------------
+
+void ConnectionShape::drawLowDetail(QPainter &painter)
+{
+    if (mPath.size() < 2)
+        return;
+
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setPen(QPen(Qt::black, 0));
+    painter.drawPolyline(mPath.constData(), mPath.size());
+}
+
+// ----------------------------------------------------------------------------
+
 } } // namespaces
 
 // ----------------------------------------------------------------------------
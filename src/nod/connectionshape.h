@@ -6,11 +6,13 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QPainterPath>
 #include <QVector>
 
 // ----------------------------------------------------------------------------
 
 #include "nod/common.h"
+#include "nod/pathplanner.h"
 
 // ----------------------------------------------------------------------------
 
@@ -34,15 +36,35 @@ public:
 
     const QVector<QPointF>      &path() const { return mPath; }
 
+    /// Incremented whenever the path changes, used to validate cached data.
+    int                         version() const { return mVersion; }
+
     /** Plans a path on the grid.
      *
+     * The search state is kept with the shape, so in incremental planner
+     * mode only the changed part of the grid is searched again.
      * Calls updateShape() after the new path was determined.
      *
      */
     virtual void                updatePath(const QPointF &start, const QPointF &end);
 
+    /** Sets a straight path without planning.
+     *
+     * Used as a cheap preview, calls updateShape() as well.
+     *
+     */
+    virtual void                setStraightPath(const QPointF &start, const QPointF &end);
+
     virtual QRectF              boundingRect() const=0;
 
+    /** Returns the outline of the shape.
+     *
+     * Used for hit testing and selection, implementations should cache it
+     * until the path changes.
+     *
+     */
+    virtual QPainterPath        shape() const=0;
+
     /** Draws the shape.
      *
      * @param painter The painter to draw with.
@@ -50,6 +72,16 @@ public:
      */
     virtual void                draw(QPainter &painter)=0;
 
+    /** Draws the shape when zoomed out far.
+     *
+     * The default implementation draws the planned path as a plain polyline
+     * without antialiasing.
+     *
+     * @param painter The painter to draw with.
+     *
+     */
+    virtual void                drawLowDetail(QPainter &painter);
+
     /** Updates grid cells depending on shape.
      *
      */
@@ -63,6 +95,8 @@ private:
 
     NodeGrid                    &mGrid;
     QVector<QPointF>            mPath;
+    int                         mVersion = 0;
+    PathPlanner::State          mPlanState;
 };
 
 // ----------------------------------------------------------------------------
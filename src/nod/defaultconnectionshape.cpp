@@ -20,21 +20,32 @@ namespace nod { namespace qgs {
 DefaultConnectionShape::DefaultConnectionShape(NodeGrid &grid)
     : ConnectionShape(grid)
 {
+    // TODO: add style object
+    mPen.setWidth(2);
+    mPen.setCapStyle(Qt::RoundCap);
+    mPen.setJoinStyle(Qt::RoundJoin);
 }
 
 // ----------------------------------------------------------------------------
 
 void DefaultConnectionShape::draw(QPainter &painter)
 {
-    // TODO: add style object
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.fillPath(stroke(), mPen.brush());
+}
+
+// ----------------------------------------------------------------------------
 
-    QPen pen;
-    pen.setWidth(2);
-    pen.setCapStyle(Qt::RoundCap);
-    pen.setJoinStyle(Qt::RoundJoin);
+const QPainterPath &DefaultConnectionShape::stroke() const
+{
+    if (mStrokeVersion != version())
+    {
+        QPainterPathStroker stroker(mPen);
+        mStroke = stroker.createStroke(mCurve);
+        mStrokeVersion = version();
+    }
 
-    painter.setRenderHint(QPainter::Antialiasing);
-    painter.strokePath(mCurve, pen);
+    return mStroke;
 }
 
 // ----------------------------------------------------------------------------
@@ -134,7 +145,8 @@ void DefaultConnectionShape::updateShape()
     }
 
     auto size = maxp - minp;
-    mBounds = QRectF(minp, QSizeF(size.x(), size.y()));
+    auto pw = mPen.widthF() / 2.0;
+    mBounds = QRectF(minp, QSizeF(size.x(), size.y())).adjusted(-pw, -pw, pw, pw);
 
     //qDebug() << "DefaultConnectionShape: bounds" << mBounds;
 
@@ -7,6 +7,7 @@
 // ----------------------------------------------------------------------------
 
 #include <QPainterPath>
+#include <QPen>
 
 // ----------------------------------------------------------------------------
 
@@ -28,6 +29,8 @@ public:
 
     QRectF                      boundingRect() const override { return mBounds; }
 
+    QPainterPath                shape() const override { return stroke(); }
+
     void                        draw(QPainter &painter) override;
 
     void                        updateGrid() override;
@@ -36,10 +39,16 @@ protected:
 
     void                        updateShape() override;
 
+    /// Returns the stroked curve, rebuilt only if the path version changed.
+    const QPainterPath          &stroke() const;
+
 private:
 
+    QPen                        mPen;
     QRectF                      mBounds;
     QPainterPath                mCurve;
+    mutable QPainterPath        mStroke;
+    mutable int                 mStrokeVersion = -1;
 };
 
 // ----------------------------------------------------------------------------
@@ -58,6 +58,37 @@ DefaultNodeItem::Style DefaultNodeItem::defaultStyle()
 
 // ----------------------------------------------------------------------------
 
+void DefaultNodeItem::setStyle(const Style &style)
+{
+    mStyle = style;
+    invalidateGeometry();
+}
+
+// ----------------------------------------------------------------------------
+
+const DefaultNodeItem::Geometry &DefaultNodeItem::cachedGeometry() const
+{
+    auto rc = boundingRect();
+    if (mGeometry.valid && mGeometry.bounds == rc)
+        return mGeometry;
+
+    mGeometry.valid = true;
+    mGeometry.bounds = rc;
+    mGeometry.clip = clipPath(rc);
+    mGeometry.port_rects.clear();
+    mGeometry.label_rects.clear();
+
+    for (auto &entry : portTable().ports)
+    {
+        mGeometry.port_rects.append(calculatePortRect(rc, entry));
+        mGeometry.label_rects.append(calculatePortLabelRect(rc, entry));
+    }
+
+    return mGeometry;
+}
+
+// ----------------------------------------------------------------------------
+
 void DefaultNodeItem::drawBackground(QPainter &painter, const QRectF &rect)
 {
     painter.fillRect(rect, isSelected() ? mStyle.node_brush_select : mStyle.node_brush);
@@ -67,11 +98,13 @@ void DefaultNodeItem::drawBackground(QPainter &painter, const QRectF &rect)
 
 void DefaultNodeItem::drawHeader(QPainter &painter, const QRectF &rect)
 {
-    auto caption = model()->nodeData(node(), DataRole::Display);
-    if (caption.isNull())
-        caption = model()->nodeData(node(), DataRole::Name);
+    if (detailLevel() != DetailLevel::Full)
+    {
+        painter.fillRect(rect, isSelected() ? mStyle.node_header_brush_select : mStyle.node_header_brush);
+        return;
+    }
 
-    drawHeader(painter, rect, caption.toString());
+    drawHeader(painter, rect, caption());
 }
 
 // ----------------------------------------------------------------------------
@@ -85,11 +118,10 @@ void DefaultNodeItem::drawContent(QPainter &, const QRectF &)
 
 void DefaultNodeItem::drawPort(QPainter &painter, const QRectF &rect, const PortID &port)
 {
-    auto color_data = model()->portData(node(), port, DataRole::Color);
-    if (!color_data.isValid())
-        color_data = mStyle.port_default_color;
+    auto color = model()->portColor(node(), port);
+    if (!color.isValid())
+        color = mStyle.port_default_color;
 
-    auto color = qvariant_cast<QColor>(color_data);
     painter.setBrush(color);
     painter.setPen(color.darker());
     painter.drawEllipse(rect);
@@ -99,12 +131,15 @@ void DefaultNodeItem::drawPort(QPainter &painter, const QRectF &rect, const Port
 
 void DefaultNodeItem::drawPortLabel(QPainter &painter, const QRectF &rect, const PortID &port)
 {
-    auto caption = model()->portData(node(), port, DataRole::Display);
-    if (caption.isNull())
-        caption = model()->portData(node(), port, DataRole::Name);
+    auto entry = portEntry(port);
+    if (entry < 0)
+        return;
+
+    auto &label = portLabel(entry);
 
     painter.setPen(mStyle.port_label_pen);
-    painter.drawText(rect, Qt::TextSingleLine | Qt::AlignVCenter, caption.toString());
+    painter.setFont(label.font);
+    drawLabel(painter, label, rect.topLeft());
 }
 
 // ----------------------------------------------------------------------------
@@ -130,14 +165,70 @@ QRectF DefaultNodeItem::contentRect(const QRectF &rc) const
 
 // ----------------------------------------------------------------------------
 
+QPainterPath DefaultNodeItem::clipPath(const QRectF &rc) const
+{
+    QPainterPath clip;
+    int gs = scene().grid().gridSize();
+
+    int curved = gs / 3;
+    int straight = gs - curved;
+
+    int r = rc.right() - straight - curved;
+    int b = rc.bottom() - straight - curved;
+
+    clip.moveTo(0, gs);
+    clip.lineTo(0, gs - straight);
+    clip.quadTo(0, 0, curved, 0);
+    clip.lineTo(r + straight, 0);
+    clip.quadTo(r + straight + curved, 0, r + straight + curved, curved);
+    clip.lineTo(r + straight + curved, b + straight);
+    clip.quadTo(r + straight + curved, b + straight + curved, r + straight, b + straight + curved);
+    clip.lineTo(curved, b + straight + curved);
+    clip.quadTo(0, b + straight + curved, 0, b + straight);
+    clip.lineTo(0, gs);
+
+    return clip;
+}
+
+// ----------------------------------------------------------------------------
+
 QRectF DefaultNodeItem::portRect(const QRectF &rc, const PortID &port) const
 {
-    auto direction = model()->portDirection(node(), port);
-    auto index = portIndex(port, direction);
-    Q_ASSERT(index >= 0);
-    if (index < 0)
+    auto entry = portEntry(port);
+    Q_ASSERT(entry >= 0);
+    if (entry < 0)
+        return QRectF();
+
+    auto &geometry = cachedGeometry();
+    if (rc == geometry.bounds)
+        return geometry.port_rects[entry];
+
+    return calculatePortRect(rc, portTable().ports[entry]);
+}
+
+// ----------------------------------------------------------------------------
+
+QRectF DefaultNodeItem::portLabelRect(const QRectF &rc, const PortID &port) const
+{
+    auto entry = portEntry(port);
+    Q_ASSERT(entry >= 0);
+    if (entry < 0)
         return QRectF();
 
+    auto &geometry = cachedGeometry();
+    if (rc == geometry.bounds)
+        return geometry.label_rects[entry];
+
+    return calculatePortLabelRect(rc, portTable().ports[entry]);
+}
+
+// ----------------------------------------------------------------------------
+
+QRectF DefaultNodeItem::calculatePortRect(const QRectF &rc, const PortEntry &port) const
+{
+    auto direction = port.direction;
+    auto index = port.index;
+
     int size = mStyle.port_radius * 2;
     int gs = scene().grid().gridSize();
     int gsh = gs >> 1;
@@ -151,42 +242,37 @@ QRectF DefaultNodeItem::portRect(const QRectF &rc, const PortID &port) const
 
 // ----------------------------------------------------------------------------
 
-QRectF DefaultNodeItem::portLabelRect(const QRectF &rc, const PortID &port) const
+QRectF DefaultNodeItem::calculatePortLabelRect(const QRectF &rc, const PortEntry &port) const
 {
-    auto direction = model()->portDirection(node(), port);
-    auto port_rc = portRect(rc, port);
+    auto direction = port.direction;
+    auto port_rc = calculatePortRect(rc, port);
 
-    auto name = model()->portData(node(), port, DataRole::Name);
-    if (name.isNull())
-        name = model()->portData(node(), port, DataRole::Display);
-
-    QFontMetricsF m(mStyle.port_label_font);
-    auto text_rc = m.boundingRect(QRectF(0, 0, 0xfffff, port_rc.height()), Qt::TextSingleLine | Qt::AlignVCenter, name.toString());
+    auto text_size = portLabel(portEntry(port.id)).layout.size();
 
     auto x = 0;
-    auto y = port_rc.top() + (port_rc.height() / 2 - text_rc.height() / 2);
+    auto y = port_rc.top() + (port_rc.height() / 2 - text_size.height() / 2);
 
     if (direction == Direction::Output)
     {
-        x = port_rc.left() - mStyle.port_label_spacing - text_rc.width();
+        x = port_rc.left() - mStyle.port_label_spacing - text_size.width();
     } else
         x = port_rc.right() + mStyle.port_label_spacing;
 
-    return QRectF(QPointF(x, y), text_rc.size());
+    return QRectF(QPointF(x, y), text_size);
 }
 
 // ----------------------------------------------------------------------------
 
 void DefaultNodeItem::updateGrid()
 {
-    auto rc = boundingRect();
+    auto &geometry = cachedGeometry();
+    auto rc = geometry.bounds;
     auto scene_rc = QRectF(mapToScene(rc.topLeft()), rc.size());
 
     scene().grid().setUsage(scene_rc.adjusted(0, 0, -1, -1), CellUsage::Node);
 
-    for (auto it=model()->firstPort(node()); !it.atEnd(); it.next())
+    for (auto &prc : geometry.port_rects)
     {
-        auto prc = portRect(rc, it.port());
         auto pt = scene_rc.topLeft() + prc.topLeft();
         //auto pt = mapToScene(prc.topLeft());
         //auto pt = prc.topLeft();
@@ -196,42 +282,38 @@ void DefaultNodeItem::updateGrid()
 
 // ----------------------------------------------------------------------------
 
-QSizeF DefaultNodeItem::calculateContentSize() const
+void DefaultNodeItem::invalidateGeometry()
 {
-    return QSizeF(0, 0);
+    NodeItem::invalidateGeometry();
+    mGeometry.valid = false;
+    mPortLabels.clear();
 }
 
 // ----------------------------------------------------------------------------
 
-void DefaultNodeItem::draw(QPainter &painter)
+void DefaultNodeItem::invalidateCaption()
 {
-    QRectF rc = boundingRect();
-
-    // TODO: cache clip path and sizes
+    NodeItem::invalidateCaption();
+    mHeaderLabel.valid = false;
+}
 
-    painter.setRenderHint(QPainter::Antialiasing);
+// ----------------------------------------------------------------------------
 
-    QPainterPath clip;
-    int gs = scene().grid().gridSize();
+QSizeF DefaultNodeItem::calculateContentSize() const
+{
+    return QSizeF(0, 0);
+}
 
-    int curved = gs / 3;
-    int straight = gs - curved;
+// ----------------------------------------------------------------------------
 
-    int r = rc.right() - straight - curved;
-    int b = rc.bottom() - straight - curved;
+void DefaultNodeItem::draw(QPainter &painter)
+{
+    auto &geometry = cachedGeometry();
+    QRectF rc = geometry.bounds;
 
-    clip.moveTo(0, gs);
-    clip.lineTo(0, gs - straight);
-    clip.quadTo(0, 0, curved, 0);
-    clip.lineTo(r + straight, 0);
-    clip.quadTo(r + straight + curved, 0, r + straight + curved, curved);
-    clip.lineTo(r + straight + curved, b + straight);
-    clip.quadTo(r + straight + curved, b + straight + curved, r + straight, b + straight + curved);
-    clip.lineTo(curved, b + straight + curved);
-    clip.quadTo(0, b + straight + curved, 0, b + straight);
-    clip.lineTo(0, gs);
+    painter.setRenderHint(QPainter::Antialiasing);
 
-    painter.setClipPath(clip);
+    painter.setClipPath(geometry.clip);
 
     drawBackground(painter, rc);
 
@@ -241,17 +323,20 @@ void DefaultNodeItem::draw(QPainter &painter)
     auto content = contentRect(rc);
     drawContent(painter, content);
 
-    auto drawPorts = [this, &painter, &rc] (Direction direction)
+    auto &ports = portTable().ports;
+
+    auto drawPorts = [this, &painter, &geometry, &ports] (Direction direction)
     {
-        for (auto it=model()->firstPort(node()), end=model()->endPort(node()); it!=end; it.next())
+        for (int i=0; i<ports.size(); ++i)
         {
-            if (model()->portDirection(it.node(), it.port()) == direction)
+            if (ports[i].direction == direction)
             {
-                auto port_rect = portRect(rc, it.port());
-                drawPort(painter, port_rect, it.port());
+                drawPort(painter, geometry.port_rects[i], ports[i].id);
 
-                auto label_rect = portLabelRect(rc, it.port());
-                drawPortLabel(painter, label_rect, it.port());
+                if (detailLevel() != DetailLevel::Full)
+                    continue;
+
+                drawPortLabel(painter, geometry.label_rects[i], ports[i].id);
             }
         }
     };
@@ -264,7 +349,18 @@ void DefaultNodeItem::draw(QPainter &painter)
     // TODO: add to style
     QPen pen(isSelected() ? mStyle.node_pen_select : mStyle.node_pen);
     pen.setWidthF(2.6f);
-    painter.strokePath(clip, pen);
+    painter.strokePath(geometry.clip, pen);
+}
+
+// ----------------------------------------------------------------------------
+
+void DefaultNodeItem::drawLowDetail(QPainter &painter)
+{
+    QRectF rc = boundingRect();
+
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.fillRect(rc, isSelected() ? mStyle.node_brush_select : mStyle.node_brush);
+    painter.fillRect(headerRect(rc), isSelected() ? mStyle.node_header_brush_select : mStyle.node_header_brush);
 }
 
 // ----------------------------------------------------------------------------
@@ -317,26 +413,83 @@ void DefaultNodeItem::drawHeader(QPainter &painter, const QRectF &rect, const QS
 {
     painter.fillRect(rect, isSelected() ? mStyle.node_header_brush_select : mStyle.node_header_brush);
     painter.setFont(mStyle.node_header_text_font);
-
-    QTextOption o;
-    o.setAlignment(Qt::AlignCenter | Qt::AlignVCenter);
-    o.setFlags(QTextOption::IncludeTrailingSpaces);
-    o.setWrapMode(QTextOption::NoWrap);
     painter.setPen(mStyle.node_header_text_pen);
-    painter.drawText(rect, text, o);
+
+    updateLabel(mHeaderLabel, text, mStyle.node_header_text_font);
+
+    auto size = mHeaderLabel.layout.size();
+    auto center = rect.center();
+    drawLabel(painter, mHeaderLabel, QPointF(center.x() - size.width() / 2, center.y() - size.height() / 2));
+}
+
+// ----------------------------------------------------------------------------
+
+void DefaultNodeItem::updateLabel(Label &label, const QString &text, const QFont &font)
+{
+    if (label.valid && label.text == text && label.font == font)
+        return;
+
+    label.valid = true;
+    label.text = text;
+    label.font = font;
+
+    label.layout = QStaticText(text);
+    label.layout.setTextFormat(Qt::PlainText);
+    label.layout.setPerformanceHint(QStaticText::AggressiveCaching);
+    label.layout.prepare(QTransform(), font);
+}
+
+// ----------------------------------------------------------------------------
+
+void DefaultNodeItem::drawLabel(QPainter &painter, const Label &label, const QPointF &pos)
+{
+    // the layout is prepared without scale, QPainter transforms the cached
+    // glyph positions instead of laying the text out again per zoom level
+    painter.drawStaticText(pos, label.layout);
+}
+
+// ----------------------------------------------------------------------------
+
+const QString &DefaultNodeItem::caption() const
+{
+    if (!mHeaderLabel.valid)
+        updateLabel(mHeaderLabel, model()->nodeCaption(node()), mStyle.node_header_text_font);
+
+    return mHeaderLabel.text;
+}
+
+// ----------------------------------------------------------------------------
+
+DefaultNodeItem::Label &DefaultNodeItem::portLabel(int entry) const
+{
+    auto &ports = portTable().ports;
+    if (mPortLabels.size() != ports.size())
+        mPortLabels.resize(ports.size());
+
+    auto &label = mPortLabels[entry];
+    if (!label.valid)
+        updateLabel(label, portLabelText(ports[entry].id), mStyle.port_label_font);
+
+    return label;
+}
+
+// ----------------------------------------------------------------------------
+
+QString DefaultNodeItem::portLabelText(const PortID &port) const
+{
+    return model()->portCaption(node(), port);
 }
 
 // ----------------------------------------------------------------------------
 
 PortID DefaultNodeItem::portAt(const QPointF &pos) const
 {
-    QRectF rc = boundingRect();
+    auto &geometry = cachedGeometry();
 
-    for (auto it=model()->firstPort(node()), end=model()->endPort(node()); it!=end; it.next())
+    for (int i=0; i<geometry.port_rects.size(); ++i)
     {
-        auto rect = portRect(rc, it.port());
-        if (rect.contains(pos))
-            return it.port();
+        if (geometry.port_rects[i].contains(pos))
+            return portTable().ports[i].id;
     }
 
     return PortID::invalid();
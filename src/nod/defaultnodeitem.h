@@ -6,6 +6,13 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QFont>
+#include <QPainterPath>
+#include <QStaticText>
+#include <QVector>
+
+// ----------------------------------------------------------------------------
+
 #include "nod/nodeitem.h"
 
 // ----------------------------------------------------------------------------
@@ -40,10 +47,31 @@ public:
         QPen                    port_label_pen;
     };
 
+    /// Geometry cached between paints, see cachedGeometry().
+    struct Geometry
+    {
+        bool                    valid = false;
+        QRectF                  bounds;
+        QPainterPath            clip;
+        QVector<QRectF>         port_rects;     // parallel to NodeItem::portTable()
+        QVector<QRectF>         label_rects;    // parallel to NodeItem::portTable()
+    };
+
     using NodeItem::NodeItem;
 
     static Style                defaultStyle();
 
+    const Style                 &style() const { return mStyle; }
+
+    void                        setStyle(const Style &style);
+
+    /** Returns the geometry for the current bounding rect.
+     *
+     * The cache is rebuilt lazily after invalidateGeometry().
+     *
+     */
+    const Geometry              &cachedGeometry() const;
+
     virtual void                drawBackground(QPainter &painter, const QRectF &rect);
 
     virtual void                drawHeader(QPainter &painter, const QRectF &rect);
@@ -60,12 +88,16 @@ public:
 
     virtual QRectF              contentRect(const QRectF &rc) const;
 
+    virtual QPainterPath        clipPath(const QRectF &rc) const;
+
     virtual QSizeF              calculateContentSize() const;
 
     /* NodeItem */
 
     void                        draw(QPainter &painter) override;
 
+    void                        drawLowDetail(QPainter &painter) override;
+
     virtual QSizeF              calculateItemSize() const override;
 
     PortID                      portAt(const QPointF &pos) const override;
@@ -76,13 +108,43 @@ public:
 
     void                        updateGrid() override;
 
+    void                        invalidateGeometry() override;
+
+    void                        invalidateCaption() override;
+
 protected:
 
     virtual void                drawHeader(QPainter &painter, const QRectF &rect, const QString &text);
 
 private:
 
+    /// Text laid out once and reused across paints and size calculations.
+    struct Label
+    {
+        bool                    valid = false;
+        QString                 text;
+        QFont                   font;
+        QStaticText             layout;
+    };
+
     Style                       mStyle = defaultStyle();
+    mutable Geometry            mGeometry;
+    mutable Label               mHeaderLabel;
+    mutable QVector<Label>      mPortLabels;    // parallel to NodeItem::portTable()
+
+    static void                 updateLabel(Label &label, const QString &text, const QFont &font);
+
+    static void                 drawLabel(QPainter &painter, const Label &label, const QPointF &pos);
+
+    const QString               &caption() const;
+
+    Label                       &portLabel(int entry) const;
+
+    QString                     portLabelText(const PortID &port) const;
+
+    QRectF                      calculatePortRect(const QRectF &rc, const PortEntry &port) const;
+
+    QRectF                      calculatePortLabelRect(const QRectF &rc, const PortEntry &port) const;
 };
 
 // ----------------------------------------------------------------------------
@@ -34,8 +34,14 @@ ConnectionItem *DefaultNodeItemFactory::createConnectionItem(const NodeID &node,
 
     auto shape = createConnectionShape();
     auto item = new ConnectionItem(scene(), connection, shape);
-    item->updatePath();
-    item->updateGrid();
+
+    // routed once by NodeScene::endBatch()
+    if (!scene().isBatching())
+    {
+        item->updatePath();
+        item->updateGrid();
+    }
+
     return item;
 }
 
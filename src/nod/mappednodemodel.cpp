@@ -0,0 +1,735 @@
+
+// ----------------------------------------------------------------------------
+
+#include <cstring>
+#include <limits>
+
+// ----------------------------------------------------------------------------
+
+#include <QIODevice>
+#include <QRectF>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/mappednodemodel.h"
+
+// ----------------------------------------------------------------------------
+
+namespace nod {
+
+// ----------------------------------------------------------------------------
+
+static const quint32 ByteOrderMark = 0x01020304;
+static const quint32 NoString = 0xffffffff;
+static const qint32 NotConnected = -1;
+
+// ----------------------------------------------------------------------------
+
+struct MappedNodeModel::FileHeader
+{
+    quint32                     magic;
+    quint32                     version;
+    quint32                     byte_order;
+    quint32                     reserved;
+    quint64                     node_count;
+    quint64                     port_count;
+    quint64                     string_count;
+    quint64                     nodes;          // file offsets
+    quint64                     ports;
+    quint64                     string_offsets;
+    quint64                     string_data;
+    quint64                     string_data_size;
+};
+
+// ----------------------------------------------------------------------------
+
+struct MappedNodeModel::NodeRecord
+{
+    uchar                       id[16];         // RFC 4122
+    uchar                       type[16];
+    double                      x, y;
+    double                      width, height;
+    quint32                     name;           // string index or NoString
+    quint32                     display;
+    quint32                     first_port;
+    quint32                     port_count;
+};
+
+// ----------------------------------------------------------------------------
+
+struct MappedNodeModel::PortRecord
+{
+    uchar                       id[16];
+    quint32                     node;
+    quint32                     name;
+    quint32                     display;
+    quint32                     direction;
+    qint32                      connected;      // port index or NotConnected
+    quint32                     color;          // ARGB, 0 if not set
+};
+
+// ----------------------------------------------------------------------------
+
+static QUuid toUuid(const uchar *bytes)
+{
+    return QUuid::fromRfc4122(QByteArray::fromRawData(reinterpret_cast<const char *>(bytes), 16));
+}
+
+// ----------------------------------------------------------------------------
+
+static void fromUuid(uchar *bytes, const QUuid &uuid)
+{
+    auto data = uuid.toRfc4122();
+    std::memcpy(bytes, data.constData(), 16);
+}
+
+// ----------------------------------------------------------------------------
+
+MappedNodeModel::MappedNodeModel(QObject *parent)
+    : NodeModel(parent)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+MappedNodeModel::~MappedNodeModel()
+{
+    unmap();
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::open(const QString &filename)
+{
+    unmap();
+    bool ok = map(filename);
+
+    // a single reset instead of a notification per node, views read the
+    // nodes they need, records are paged in on access
+    emit modelReset(*this);
+
+    return ok;
+}
+
+// ----------------------------------------------------------------------------
+
+void MappedNodeModel::close()
+{
+    if (!mData)
+        return;
+
+    unmap();
+    emit modelReset(*this);
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::map(const QString &filename)
+{
+    mFile.setFileName(filename);
+    if (!mFile.open(QIODevice::ReadOnly))
+        return false;
+
+    mSize = mFile.size();
+    if (mSize < qint64(sizeof(FileHeader)))
+    {
+        unmap();
+        return false;
+    }
+
+    mData = mFile.map(0, mSize);
+    if (!mData)
+    {
+        unmap();
+        return false;
+    }
+
+    mHeader = reinterpret_cast<const FileHeader *>(mData);
+
+    auto fits = [this] (quint64 offset, quint64 count, quint64 size) -> bool {
+        return offset <= quint64(mSize) && count <= (quint64(mSize) - offset) / size;
+    };
+
+    // tables are written at multiples of 8, see write()
+    auto aligned = [] (quint64 offset) -> bool {
+        return offset % 8 == 0;
+    };
+
+    // the counts are limited before adding to them, the record ranges are
+    // checked on access, see validPorts()
+    const auto max_count = quint64(std::numeric_limits<int>::max());
+    if (mHeader->magic != quint32(Magic) || mHeader->version > Version ||
+        mHeader->byte_order != ByteOrderMark ||
+        mHeader->node_count > max_count ||
+        mHeader->port_count > max_count ||
+        mHeader->string_count > max_count ||
+        !aligned(mHeader->nodes) || !aligned(mHeader->ports) || !aligned(mHeader->string_offsets) ||
+        !fits(mHeader->nodes, mHeader->node_count, sizeof(NodeRecord)) ||
+        !fits(mHeader->ports, mHeader->port_count, sizeof(PortRecord)) ||
+        !fits(mHeader->string_offsets, mHeader->string_count + 1, sizeof(quint64)) ||
+        !fits(mHeader->string_data, mHeader->string_data_size, 1))
+    {
+        unmap();
+        return false;
+    }
+
+    mNodes = reinterpret_cast<const NodeRecord *>(mData + mHeader->nodes);
+    mPorts = reinterpret_cast<const PortRecord *>(mData + mHeader->ports);
+    mStringOffsets = reinterpret_cast<const quint64 *>(mData + mHeader->string_offsets);
+    mStringData = reinterpret_cast<const char *>(mData + mHeader->string_data);
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void MappedNodeModel::unmap()
+{
+    if (mData)
+        mFile.unmap(const_cast<uchar *>(mData));
+
+    mFile.close();
+
+    mData = nullptr;
+    mSize = 0;
+    mHeader = nullptr;
+    mNodes = nullptr;
+    mPorts = nullptr;
+    mStringOffsets = nullptr;
+    mStringData = nullptr;
+    mNodeIndex.clear();
+    mPortIndex.clear();
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::write(const NodeModel &model, QIODevice &device)
+{
+    QVector<NodeRecord> nodes;
+    QVector<PortRecord> ports;
+    QHash<QUuid, int> port_index;
+    QHash<QString, quint32> string_index;
+    QVector<quint64> string_offsets;
+    QByteArray string_data;
+
+    auto addString = [&] (const QVariant &value) -> quint32 {
+        if (value.isNull())
+            return NoString;
+
+        auto str = value.toString();
+        auto it = string_index.constFind(str);
+        if (it != string_index.constEnd())
+            return *it;
+
+        quint32 index = quint32(string_offsets.size());
+        string_offsets.append(quint64(string_data.size()));
+        string_data.append(str.toUtf8());
+        string_index.insert(str, index);
+        return index;
+    };
+
+    for (auto &node : model.nodes())
+    {
+        NodeRecord rec;
+        std::memset(&rec, 0, sizeof(rec));
+
+        fromUuid(rec.id, node.value);
+        fromUuid(rec.type, model.nodeData(node, DataRole::Type).toUuid());
+
+        auto pos = model.nodePosition(node);
+        auto size = model.nodeSize(node);
+        rec.x = pos.x();
+        rec.y = pos.y();
+        rec.width = size.width();
+        rec.height = size.height();
+        rec.name = addString(model.nodeData(node, DataRole::Name));
+        rec.display = addString(model.nodeData(node, DataRole::Display));
+        rec.first_port = quint32(ports.size());
+
+        for (auto &port : model.ports(node))
+        {
+            PortRecord prec;
+            std::memset(&prec, 0, sizeof(prec));
+
+            fromUuid(prec.id, port.value);
+            prec.node = quint32(nodes.size());
+            prec.name = addString(model.portData(node, port, DataRole::Name));
+            prec.display = addString(model.portData(node, port, DataRole::Display));
+            prec.direction = quint32(model.portDirection(node, port));
+            prec.connected = NotConnected;
+
+            auto color = model.portColor(node, port);
+            prec.color = color.isValid() ? color.rgba() : 0;
+
+            port_index.insert(port.value, ports.size());
+            ports.append(prec);
+        }
+
+        rec.port_count = quint32(ports.size()) - rec.first_port;
+        nodes.append(rec);
+    }
+
+    // resolve connections once all ports have an index
+    for (auto &node : model.nodes())
+    {
+        for (auto &port : model.ports(node))
+        {
+            PortID other_port;
+            if (!model.connectedNode(node, port, &other_port).isValid())
+                continue;
+
+            auto it = port_index.constFind(other_port.value);
+            if (it != port_index.constEnd())
+                ports[port_index.value(port.value)].connected = *it;
+        }
+    }
+
+    string_offsets.append(quint64(string_data.size()));
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = Magic;
+    header.version = Version;
+    header.byte_order = ByteOrderMark;
+    header.node_count = quint64(nodes.size());
+    header.port_count = quint64(ports.size());
+    header.string_count = quint64(string_offsets.size() - 1);
+    // keeps every table at a multiple of 8, map() rejects other offsets
+    static_assert(sizeof(FileHeader) % 8 == 0 && sizeof(NodeRecord) % 8 == 0 && sizeof(PortRecord) % 8 == 0,
+                  "record sizes must keep the tables aligned");
+
+    header.nodes = sizeof(FileHeader);
+    header.ports = header.nodes + quint64(nodes.size()) * sizeof(NodeRecord);
+    header.string_offsets = header.ports + quint64(ports.size()) * sizeof(PortRecord);
+    header.string_data = header.string_offsets + quint64(string_offsets.size()) * sizeof(quint64);
+    header.string_data_size = quint64(string_data.size());
+
+    auto write = [&device] (const void *data, qint64 size) -> bool {
+        return device.write(reinterpret_cast<const char *>(data), size) == size;
+    };
+
+    return write(&header, sizeof(header)) &&
+           write(nodes.constData(), qint64(nodes.size()) * qint64(sizeof(NodeRecord))) &&
+           write(ports.constData(), qint64(ports.size()) * qint64(sizeof(PortRecord))) &&
+           write(string_offsets.constData(), qint64(string_offsets.size()) * qint64(sizeof(quint64))) &&
+           write(string_data.constData(), string_data.size());
+}
+
+// ----------------------------------------------------------------------------
+
+QVariant MappedNodeModel::nodeData(const NodeID &node, DataRole role) const
+{
+    int index = nodeIndex(node);
+    if (index < 0)
+        return QVariant();
+
+    auto &rec = mNodes[index];
+    switch (role)
+    {
+    case DataRole::Display:
+        return rec.display != NoString ? string(rec.display) : QVariant();
+    case DataRole::Name:
+        return rec.name != NoString ? string(rec.name) : QVariant();
+    case DataRole::Position:
+        return QPointF(rec.x, rec.y);
+    case DataRole::Size:
+        return QSizeF(rec.width, rec.height);
+    case DataRole::Type:
+        return toUuid(rec.type);
+    default:
+        break;
+    }
+
+    return QVariant();
+}
+
+// ----------------------------------------------------------------------------
+
+void MappedNodeModel::setNodeData(const NodeID &node, const QVariant &value, DataRole role)
+{
+    Q_UNUSED(node);
+    Q_UNUSED(value);
+    Q_UNUSED(role);
+}
+
+// ----------------------------------------------------------------------------
+
+NodeIt MappedNodeModel::firstNode() const
+{
+    if (!mHeader || mHeader->node_count == 0)
+        return endNode();
+
+    return { const_cast<MappedNodeModel &>(*this), nodeID(0), 0 };
+}
+
+// ----------------------------------------------------------------------------
+
+NodeIt MappedNodeModel::endNode() const
+{
+    return { const_cast<MappedNodeModel &>(*this), NodeID::invalid(), uint64_t(-1) };
+}
+
+// ----------------------------------------------------------------------------
+
+void MappedNodeModel::nextNode(NodeIt &it) const
+{
+    if (it.data() == uint64_t(-1))
+        return;
+
+    auto index = it.data() + 1;
+    if (index < mHeader->node_count)
+        it.update(nodeID(int(index)), index);
+    else
+        it = endNode();
+}
+
+// ----------------------------------------------------------------------------
+
+QPointF MappedNodeModel::nodePosition(const NodeID &node) const
+{
+    int index = nodeIndex(node);
+    return index >= 0 ? QPointF(mNodes[index].x, mNodes[index].y) : QPointF();
+}
+
+// ----------------------------------------------------------------------------
+
+QSizeF MappedNodeModel::nodeSize(const NodeID &node) const
+{
+    int index = nodeIndex(node);
+    return index >= 0 ? QSizeF(mNodes[index].width, mNodes[index].height) : QSizeF();
+}
+
+// ----------------------------------------------------------------------------
+
+QString MappedNodeModel::nodeCaption(const NodeID &node) const
+{
+    int index = nodeIndex(node);
+    if (index < 0)
+        return QString();
+
+    auto &rec = mNodes[index];
+    return string(rec.display != NoString ? rec.display : rec.name);
+}
+
+// ----------------------------------------------------------------------------
+
+QString MappedNodeModel::portCaption(const NodeID &node, const PortID &port) const
+{
+    Q_UNUSED(node);
+
+    int index = portIndex(port);
+    if (index < 0)
+        return QString();
+
+    auto &rec = mPorts[index];
+    return string(rec.display != NoString ? rec.display : rec.name);
+}
+
+// ----------------------------------------------------------------------------
+
+QColor MappedNodeModel::portColor(const NodeID &node, const PortID &port) const
+{
+    Q_UNUSED(node);
+
+    int index = portIndex(port);
+    if (index < 0 || mPorts[index].color == 0)
+        return QColor();
+
+    return QColor::fromRgba(mPorts[index].color);
+}
+
+// ----------------------------------------------------------------------------
+
+PortIt MappedNodeModel::firstPort(const NodeID &node) const
+{
+    int index = nodeIndex(node);
+    if (index < 0 || mNodes[index].port_count == 0 || !validPorts(mNodes[index]))
+        return endPort(node);
+
+    auto first = mNodes[index].first_port;
+    return { const_cast<MappedNodeModel &>(*this), node, uint64_t(index), portID(int(first)), first };
+}
+
+// ----------------------------------------------------------------------------
+
+PortIt MappedNodeModel::endPort(const NodeID &node) const
+{
+    return { const_cast<MappedNodeModel &>(*this), node, uint64_t(-1), PortID::invalid(), uint64_t(-1) };
+}
+
+// ----------------------------------------------------------------------------
+
+void MappedNodeModel::nextPort(PortIt &it) const
+{
+    if (it.portData() == uint64_t(-1))
+        return;
+
+    // firstPort() checked the range
+    auto &rec = mNodes[it.nodeData()];
+    auto index = it.portData() + 1;
+    if (index < quint64(rec.first_port) + rec.port_count)
+        it.update(portID(int(index)), index);
+    else
+        it = endPort(it.node());
+}
+
+// ----------------------------------------------------------------------------
+
+QVariant MappedNodeModel::portData(const NodeID &node, const PortID &port, DataRole role) const
+{
+    Q_UNUSED(node);
+
+    int index = portIndex(port);
+    if (index < 0)
+        return QVariant();
+
+    auto &rec = mPorts[index];
+    switch (role)
+    {
+    case DataRole::Display:
+        return rec.display != NoString ? string(rec.display) : QVariant();
+    case DataRole::Name:
+        return rec.name != NoString ? string(rec.name) : QVariant();
+    case DataRole::Color:
+        return rec.color ? QColor::fromRgba(rec.color) : QVariant();
+    default:
+        break;
+    }
+
+    return QVariant();
+}
+
+// ----------------------------------------------------------------------------
+
+Direction MappedNodeModel::portDirection(const NodeID &node, const PortID &port) const
+{
+    Q_UNUSED(node);
+
+    int index = portIndex(port);
+    if (index < 0)
+        return Direction::Input;
+
+    return mPorts[index].direction == quint32(Direction::Output) ? Direction::Output : Direction::Input;
+}
+
+// ----------------------------------------------------------------------------
+
+NodeID MappedNodeModel::connectedNode(const NodeID &node, const PortID &port, PortID *other_port) const
+{
+    Q_UNUSED(node);
+
+    int index = portIndex(port);
+    if (index < 0 || mPorts[index].connected == NotConnected)
+        return NodeID::invalid();
+
+    auto other = mPorts[index].connected;
+    if (other < 0 || quint64(other) >= mHeader->port_count ||
+        mPorts[other].node >= mHeader->node_count)
+        return NodeID::invalid();
+
+    if (other_port)
+        *other_port = portID(other);
+
+    return nodeID(int(mPorts[other].node));
+}
+
+// ----------------------------------------------------------------------------
+
+PortID MappedNodeModel::connectedPort(const NodeID &node, const PortID &port) const
+{
+    PortID other_port = PortID::invalid();
+    connectedNode(node, port, &other_port);
+    return other_port;
+}
+
+// ----------------------------------------------------------------------------
+
+Connection MappedNodeModel::connection(const NodeID &node, const PortID &port) const
+{
+    PortID other_port;
+    auto other_node = connectedNode(node, port, &other_port);
+    if (!other_node.isValid())
+        return Connection::invalid();
+
+    return { node, port, other_node, other_port };
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::canConnect(const NodeID &, const PortID &, const NodeID &, const PortID &) const
+{
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::connect(const NodeID &, const PortID &, const NodeID &, const PortID &)
+{
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::disconnect(const NodeID &)
+{
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::disconnect(const NodeID &, const PortID &)
+{
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::isConnected(const NodeID &node) const
+{
+    int index = nodeIndex(node);
+    if (index < 0)
+        return false;
+
+    auto &rec = mNodes[index];
+    if (!validPorts(rec))
+        return false;
+
+    for (quint32 i=0; i<rec.port_count; ++i)
+    {
+        if (mPorts[rec.first_port + i].connected != NotConnected)
+            return true;
+    }
+
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::isConnected(const NodeID &node, const PortID &port) const
+{
+    return connectedNode(node, port).isValid();
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::isConnected(const Connection &connection) const
+{
+    PortID other_port;
+    auto other_node = connectedNode(connection.node1, connection.port1, &other_port);
+    return other_node == connection.node2 && other_port == connection.port2;
+}
+
+// ----------------------------------------------------------------------------
+
+NodeFlags MappedNodeModel::flags(const NodeID &node) const
+{
+    Q_UNUSED(node);
+    return NodeFlag::None;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::serialize(Serialized &data)
+{
+    Q_UNUSED(data);
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::writeNodes(Serialized &data, const QVector<NodeID> &nodes)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(nodes);
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+int MappedNodeModel::nodeIndex(const NodeID &node) const
+{
+    if (!mHeader || !node.isValid())
+        return -1;
+
+    // IDs handed out by the model carry their index
+    auto index = node.ivalue;
+    if (index >= 0 && quint64(index) < mHeader->node_count &&
+        toUuid(mNodes[index].id) == node.value)
+        return int(index);
+
+    if (mNodeIndex.isEmpty())
+    {
+        for (quint64 i=0; i<mHeader->node_count; ++i)
+            mNodeIndex.insert(toUuid(mNodes[i].id), int(i));
+    }
+
+    return mNodeIndex.value(node.value, -1);
+}
+
+// ----------------------------------------------------------------------------
+
+int MappedNodeModel::portIndex(const PortID &port) const
+{
+    if (!mHeader || !port.isValid())
+        return -1;
+
+    auto index = port.ivalue;
+    if (index >= 0 && quint64(index) < mHeader->port_count &&
+        toUuid(mPorts[index].id) == port.value)
+        return int(index);
+
+    if (mPortIndex.isEmpty())
+    {
+        for (quint64 i=0; i<mHeader->port_count; ++i)
+            mPortIndex.insert(toUuid(mPorts[i].id), int(i));
+    }
+
+    return mPortIndex.value(port.value, -1);
+}
+
+// ----------------------------------------------------------------------------
+
+bool MappedNodeModel::validPorts(const NodeRecord &rec) const
+{
+    return rec.first_port <= mHeader->port_count &&
+           rec.port_count <= mHeader->port_count - rec.first_port;
+}
+
+// ----------------------------------------------------------------------------
+
+NodeID MappedNodeModel::nodeID(int index) const
+{
+    NodeID id = { toUuid(mNodes[index].id), { 0 } };
+    id.ivalue = index;
+    return id;
+}
+
+// ----------------------------------------------------------------------------
+
+PortID MappedNodeModel::portID(int index) const
+{
+    PortID id = { toUuid(mPorts[index].id), { 0 } };
+    id.ivalue = index;
+    return id;
+}
+
+// ----------------------------------------------------------------------------
+
+QString MappedNodeModel::string(quint32 index) const
+{
+    if (index >= mHeader->string_count)
+        return QString();
+
+    auto begin = mStringOffsets[index];
+    auto end = mStringOffsets[index + 1];
+    if (begin > end || end > mHeader->string_data_size)
+        return QString();
+
+    return QString::fromUtf8(mStringData + begin, int(end - begin));
+}
+
+// ----------------------------------------------------------------------------
+
+} // namespace nod
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,178 @@
+
+// ----------------------------------------------------------------------------
+
+#ifndef NOD_MAPPEDNODEMODEL_H
+#define NOD_MAPPEDNODEMODEL_H
+
+// ----------------------------------------------------------------------------
+
+#include <QFile>
+#include <QHash>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/nodemodel.h"
+
+// ----------------------------------------------------------------------------
+
+class QIODevice;
+
+// ----------------------------------------------------------------------------
+
+namespace nod {
+
+// ----------------------------------------------------------------------------
+
+/** Read-only model reading directly from a memory-mapped graph file.
+ *
+ * Opening a file only maps it and emits modelReset(), node and port data is
+ * read from the mapping on access and paged in by the OS as needed. Views
+ * decide how much is read, a NodeScene creates an item per node on reset
+ * and so reads every node record.
+ *
+ * Header counts and table offsets are checked on open, record fields used
+ * as indexes are range checked on access. A corrupt file yields missing
+ * ports or connections instead of reads outside the mapping. Node and port
+ * IDs returned by the model carry their record index in ID::ivalue for O(1)
+ * access, IDs from elsewhere are resolved through a UUID index built on
+ * first use.
+ *
+ * The file stores fixed size node and port records followed by a string
+ * table, see write(). It is written in host byte order, files from hosts
+ * with a different byte order are rejected.
+ *
+ * The model can't be modified, connect(), disconnect() and setNodeData()
+ * fail or are ignored.
+ *
+ */
+class MappedNodeModel : public NodeModel
+{
+    Q_OBJECT
+public:
+
+    enum
+    {
+        Magic                   = 0x4e4f444d,   // "NODM"
+        Version                 = 1
+    };
+
+    MappedNodeModel(QObject *parent=nullptr);
+    ~MappedNodeModel() override;
+
+    /// Maps a graph file, closes a previously opened one, emits modelReset().
+    bool                        open(const QString &filename);
+
+    /// Unmaps the file, emits modelReset() if one was open.
+    void                        close();
+
+    bool                        isOpen() const { return mData != nullptr; }
+
+    /// Writes a model in the mapped file format.
+    static bool                 write(const NodeModel &model, QIODevice &device);
+
+    /* NodeModel */
+
+    QVariant                    nodeData(const NodeID &node, DataRole role) const override;
+
+    void                        setNodeData(const NodeID &node, const QVariant &value, DataRole role) override;
+
+    NodeIt                      firstNode() const override;
+
+    NodeIt                      endNode() const override;
+
+    void                        nextNode(NodeIt &it) const override;
+
+    QPointF                     nodePosition(const NodeID &node) const override;
+
+    QSizeF                      nodeSize(const NodeID &node) const override;
+
+    QString                     nodeCaption(const NodeID &node) const override;
+
+    QString                     portCaption(const NodeID &node, const PortID &port) const override;
+
+    QColor                      portColor(const NodeID &node, const PortID &port) const override;
+
+    PortIt                      firstPort(const NodeID &node) const override;
+
+    PortIt                      endPort(const NodeID &node) const override;
+
+    void                        nextPort(PortIt &it) const override;
+
+    QVariant                    portData(const NodeID &node, const PortID &port, DataRole role) const override;
+
+    Direction                   portDirection(const NodeID &node, const PortID &port) const override;
+
+    NodeID                      connectedNode(const NodeID &node, const PortID &port, PortID *other_port=nullptr) const override;
+
+    PortID                      connectedPort(const NodeID &node, const PortID &port) const override;
+
+    Connection                  connection(const NodeID &node, const PortID &port) const override;
+
+    bool                        canConnect(const NodeID &node1, const PortID &port1,
+                                           const NodeID &node2, const PortID &port2) const override;
+
+    bool                        connect(const NodeID &node1, const PortID &port1,
+                                        const NodeID &node2, const PortID &port2) override;
+
+    bool                        disconnect(const NodeID &node) override;
+
+    bool                        disconnect(const NodeID &node, const PortID &port) override;
+
+    bool                        isConnected(const NodeID &node) const override;
+
+    bool                        isConnected(const NodeID &node, const PortID &port) const override;
+
+    bool                        isConnected(const Connection &connection) const override;
+
+    NodeFlags                   flags(const NodeID &node) const override;
+
+    bool                        serialize(Serialized &data) override;
+
+    bool                        writeNodes(Serialized &data, const QVector<NodeID> &nodes) override;
+
+private:
+
+    struct FileHeader;
+    struct NodeRecord;
+    struct PortRecord;
+
+    QFile                       mFile;
+    const uchar                 *mData = nullptr;
+    qint64                      mSize = 0;
+
+    const FileHeader            *mHeader = nullptr;
+    const NodeRecord            *mNodes = nullptr;
+    const PortRecord            *mPorts = nullptr;
+    const quint64               *mStringOffsets = nullptr;
+    const char                  *mStringData = nullptr;
+
+    mutable QHash<QUuid, int>   mNodeIndex;     // built on first lookup by UUID
+    mutable QHash<QUuid, int>   mPortIndex;
+
+    bool                        map(const QString &filename);
+
+    void                        unmap();
+
+    /// True if the port range of a node record lies within the port records.
+    bool                        validPorts(const NodeRecord &rec) const;
+
+    int                         nodeIndex(const NodeID &node) const;
+
+    int                         portIndex(const PortID &port) const;
+
+    NodeID                      nodeID(int index) const;
+
+    PortID                      portID(int index) const;
+
+    QString                     string(quint32 index) const;
+};
+
+// ----------------------------------------------------------------------------
+
+} // namespace nod
+
+// ----------------------------------------------------------------------------
+
+#endif // NOD_MAPPEDNODEMODEL_H
+
+// ----------------------------------------------------------------------------
@@ -3,6 +3,7 @@
 
 #include <QDebug>
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 
 // ----------------------------------------------------------------------------
 
@@ -34,6 +35,10 @@ void NodeGrid::setSceneRect(const QRectF &rc)
 
     mCells = QSize(ceilf(rc.width() / mGridSize), ceilf(rc.height() / mGridSize));
     mGrid.resize(mCells.width() * mCells.height());    
+    ++mVersion;
+
+    mChangeBase += mChanges.size();
+    mChanges.clear();
 
     for (int j=0; j<mCells.height(); ++j)
     {
@@ -66,8 +71,16 @@ CellUsage NodeGrid::cellUsage(const QPoint &pt) const
 
 void NodeGrid::setCellUsage(const QPoint &pt, CellUsage usage)
 {
-    if (pt.x() >= 0 && pt.y() >= 0 && pt.x() < mCells.width() && pt.y() < mCells.height())
-        mGrid[pt.x() + pt.y() * mCells.width()].usage = usage;
+    if (pt.x() < 0 || pt.y() < 0 || pt.x() >= mCells.width() || pt.y() >= mCells.height())
+        return;
+
+    int index = pt.x() + pt.y() * mCells.width();
+    if (mGrid[index].usage != usage)
+    {
+        auto from = mGrid[index].usage;
+        mGrid[index].usage = usage;
+        logChange(index, from);
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -77,8 +90,11 @@ void NodeGrid::setCellUsage(const QRect &rc, CellUsage usage)
     QRect bounds(0, 0, mCells.width(), mCells.height());
 
     QRect clip = bounds.intersected(rc);
+    if (clip.isEmpty())
+        return;
 
-    auto row = &mGrid[clip.topLeft().x() + clip.topLeft().y() * mCells.width()];
+    int row_index = clip.topLeft().x() + clip.topLeft().y() * mCells.width();
+    auto row = &mGrid[row_index];
 
     auto w = clip.width();
     auto h = clip.height();
@@ -88,16 +104,83 @@ void NodeGrid::setCellUsage(const QRect &rc, CellUsage usage)
         auto col = row;
         for (int x=0; x<w; ++x)
         {
-            col->usage = usage;
+            if (col->usage != usage)
+            {
+                auto from = col->usage;
+                col->usage = usage;
+                logChange(row_index + x, from);
+            }
             col++;
         }
 
         row += pitch;
+        row_index += pitch;
     }
 }
 
 // ----------------------------------------------------------------------------
 
+bool NodeGrid::changesSince(int change_no, const int *&cells, int &count) const
+{
+    if (change_no < mChangeBase || change_no > changeCount())
+        return false;
+
+    cells = mChanges.constData() + (change_no - mChangeBase);
+    count = changeCount() - change_no;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeGrid::logChange(int index, CellUsage from)
+{
+    if (mStaging)
+    {
+        if (!mStagedFrom.contains(index))
+        {
+            mStagedFrom.insert(index, from);
+            mStaged.append(index);
+        }
+        return;
+    }
+
+    // planners with older states start over, cheaper than a long log
+    if (mChanges.size() >= mGrid.size())
+    {
+        mChangeBase += mChanges.size();
+        mChanges.clear();
+    }
+
+    mChanges.append(index);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeGrid::beginChanges()
+{
+    Q_ASSERT(!mStaging);
+    mStaging = true;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeGrid::endChanges()
+{
+    mStaging = false;
+
+    for (auto index : mStaged)
+    {
+        auto from = mStagedFrom.value(index);
+        if (mGrid[index].usage != from)
+            logChange(index, from);
+    }
+
+    mStaged.clear();
+    mStagedFrom.clear();
+}
+
+// ----------------------------------------------------------------------------
+
 QPoint NodeGrid::cellAt(const QPointF &pt) const
 {
     int cx = int(floorf((pt.x() - mOrigin.x()) / mGridSize));
@@ -234,34 +317,69 @@ int NodeGrid::cellWeight(int index)
 
 // ----------------------------------------------------------------------------
 
-void NodeGrid::draw(QPainter &painter)
+void NodeGrid::draw(QPainter &painter, const QRectF &rect)
 {
-    painter.setClipRect(mScene.sceneRect());
     // TODO: add to style
-    painter.setPen(QColor(0xac, 0xac, 0xac));
-    painter.fillRect(mScene.sceneRect(), QColor(0xbf, 0xbf, 0xbf));
+    static const QColor background(0xbf, 0xbf, 0xbf);
+    static const QColor line(0xac, 0xac, 0xac);
 
+    auto area = rect.intersected(mScene.sceneRect());
+    if (area.isEmpty() || mCells.isEmpty())
+        return;
+
+    if (mTiled)
     {
-        float x = mOrigin.x();
-        for (int i=0; i<mCells.width(); ++i)
+        if (mTile.isNull())
         {
-            painter.drawLine(x,
-                             mOrigin.y(),
-                             x,
-                             mOrigin.y() + mCells.height() * mGridSize - 1);
-            x += mGridSize;
+            int size = mGridSize * MajorLineInterval;
+            mTile = QPixmap(size, size);
+            mTile.fill(background);
+
+            QPainter tile_painter(&mTile);
+            tile_painter.setPen(line);
+            for (int i=0; i<MajorLineInterval; ++i)
+            {
+                tile_painter.drawLine(i * mGridSize, 0, i * mGridSize, size - 1);
+                tile_painter.drawLine(0, i * mGridSize, size - 1, i * mGridSize);
+            }
         }
 
-        float y = mOrigin.y();
-        for (int i=0; i<mCells.height(); ++i)
-        {
-            painter.drawLine(mOrigin.x(),
-                             y,
-                             mOrigin.x() + mCells.width() * mGridSize - 1,
-                             y);
-            y += mGridSize;
-        }
+        QBrush brush(mTile);
+        brush.setTransform(QTransform::fromTranslate(mOrigin.x(), mOrigin.y()));
+        painter.fillRect(area, brush);
+        return;
+    }
+
+    painter.fillRect(area, background);
+
+    auto lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter.worldTransform());
+    int step = lod < mMinorLineThreshold ? int(MajorLineInterval) : 1;
+
+    int i0 = qMax(0, int(floorf((area.left() - mOrigin.x()) / mGridSize)));
+    int i1 = qMin(mCells.width() - 1, int(ceilf((area.right() - mOrigin.x()) / mGridSize)));
+    int j0 = qMax(0, int(floorf((area.top() - mOrigin.y()) / mGridSize)));
+    int j1 = qMin(mCells.height() - 1, int(ceilf((area.bottom() - mOrigin.y()) / mGridSize)));
+
+    // keep major lines in place while panning
+    i0 -= i0 % step;
+    j0 -= j0 % step;
+
+    mLines.clear();
+
+    for (int i=i0; i<=i1; i+=step)
+    {
+        float x = mOrigin.x() + i * mGridSize;
+        mLines.append(QLineF(x, area.top(), x, area.bottom()));
+    }
+
+    for (int j=j0; j<=j1; j+=step)
+    {
+        float y = mOrigin.y() + j * mGridSize;
+        mLines.append(QLineF(area.left(), y, area.right(), y));
     }
+
+    painter.setPen(line);
+    painter.drawLines(mLines);
 }
 
 // ----------------------------------------------------------------------------
@@ -279,6 +397,8 @@ void NodeGrid::updateGrid(const QRectF &area)
         return;
 
     QRectF bounds = area.isNull() ? mScene.sceneRect() : area;
+
+    beginChanges();
     setUsage(bounds, CellUsage::Empty);
 
     auto items = mScene.items();
@@ -290,9 +410,57 @@ void NodeGrid::updateGrid(const QRectF &area)
             auto rc = node->sceneBoundingRect();
             if (bounds.contains(rc))
                 node->updateGrid();
-            continue;
         }
+    }
+
+    endChanges();
 
+    for (auto item : items)
+    {
+        auto connection = qgraphicsitem_cast<ConnectionItem*>(item);
+        if (connection)
+        {
+            connection->updatePath();
+            connection->updateGrid();
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeGrid::updateNode(NodeItem *node, const QRectF &old_rect)
+{
+    if (mGrid.isEmpty())
+        return;
+
+    auto rect = node->sceneBoundingRect();
+
+    beginChanges();
+
+    if (!old_rect.isNull())
+    {
+        // free the old cells and mark the nodes still overlapping them
+        setUsage(old_rect.adjusted(0, 0, -1, -1), CellUsage::Empty);
+
+        auto items = mScene.items(old_rect, Qt::IntersectsItemBoundingRect);
+        for (auto item : items)
+        {
+            auto other = qgraphicsitem_cast<NodeItem*>(item);
+            if (other && other != node)
+                other->updateGrid();
+        }
+    }
+
+    node->updateGrid();
+    endChanges();
+
+    // the node's own connections end inside its old or new rect
+    auto gs = mGridSize;
+    auto area = rect.united(old_rect).adjusted(-gs, -gs, gs, gs);
+
+    auto items = mScene.items(area, Qt::IntersectsItemBoundingRect);
+    for (auto item : items)
+    {
         auto connection = qgraphicsitem_cast<ConnectionItem*>(item);
         if (connection)
         {
@@ -6,6 +6,9 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QHash>
+#include <QLine>
+#include <QPixmap>
 #include <QVector>
 
 // ----------------------------------------------------------------------------
@@ -51,7 +54,8 @@ public:
 
     enum
     {
-        DefaultGridSize         = 24
+        DefaultGridSize         = 24,
+        MajorLineInterval       = 4     // every n-th line is a major line
     };
 
     NodeGrid(NodeScene &scene);
@@ -69,6 +73,21 @@ public:
 
     QSize                       cells() const { return mCells; }
 
+    /// Incremented whenever the cell layout changes, see setSceneRect().
+    int                         version() const { return mVersion; }
+
+    /// Number of cell usage changes logged so far, see changesSince().
+    int                         changeCount() const { return mChangeBase + mChanges.size(); }
+
+    /** Returns the indexes of the cells whose usage changed since @a change_no.
+     *
+     * The log is cleared when it grows larger than the grid or the layout
+     * changes, false is returned if it no longer reaches back far enough.
+     * Cells may be listed more than once.
+     *
+     */
+    bool                        changesSince(int change_no, const int *&cells, int &count) const;
+
     QPoint                      cellAt(const QPointF &pt) const;
 
     int                         cellIndex(const QPoint &cell);
@@ -95,11 +114,39 @@ public:
 
     PathPlanner                 &planner() { return mPlanner; }
 
+    const PathPlanner           &planner() const { return mPlanner; }
+
     void                        updateGrid();
 
     void                        updateGrid(const QRectF &area);
 
-    void                        draw(QPainter &painter);
+    /** Updates the cells of a moved node.
+     *
+     * Only the cells under @a old_rect and the node's current scene rect are
+     * marked again, and only connections crossing them are planned again.
+     *
+     */
+    void                        updateNode(NodeItem *node, const QRectF &old_rect);
+
+    /** Draws the grid lines.
+     *
+     * Only the exposed part of the grid is drawn. Minor lines are skipped
+     * if the level of detail is below minorLineThreshold().
+     *
+     * @param painter The painter to draw with.
+     * @param rect The exposed rectangle in scene coordinates.
+     *
+     */
+    void                        draw(QPainter &painter, const QRectF &rect);
+
+    void                        setMinorLineThreshold(qreal lod) { mMinorLineThreshold = lod; }
+
+    qreal                       minorLineThreshold() const { return mMinorLineThreshold; }
+
+    /// Draws the grid by filling with a cached tile instead of drawing lines.
+    void                        setTiled(bool tiled) { mTiled = tiled; }
+
+    bool                        isTiled() const { return mTiled; }
 
     void                        debugDraw(QPainter &painter);
 
@@ -113,11 +160,36 @@ private:
     QSizeF                      mSize;
 
     QSize                       mCells;
+    int                         mVersion = 0;
 
     QVector<GridCell>           mGrid;
     PathPlanner                 mPlanner;
 
+    QVector<int>                mChanges;       // changed cell indexes
+    int                         mChangeBase = 0;  // change number of mChanges[0]
+
+    bool                        mStaging = false;
+    QVector<int>                mStaged;        // cells touched while staging
+    QHash<int, CellUsage>       mStagedFrom;    // their usage before staging
+
+    qreal                       mMinorLineThreshold = 0.5;
+    bool                        mTiled = false;
+    QPixmap                     mTile;
+    QVector<QLineF>             mLines;
+
     int                         cellWeight(int index);
+
+    void                        logChange(int index, CellUsage from);
+
+    /** Collects cell changes until endChanges().
+     *
+     * Grid updates free cells and mark them again, only cells whose usage
+     * differs afterwards are logged.
+     *
+     */
+    void                        beginChanges();
+
+    void                        endChanges();
 };
 
 // ----------------------------------------------------------------------------
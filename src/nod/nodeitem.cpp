@@ -1,7 +1,12 @@
 
 // ----------------------------------------------------------------------------
 
+#include <cmath>
+
+// ----------------------------------------------------------------------------
+
 #include <QDebug>
+#include <QPainter>
 #include <QStyleOptionGraphicsItem>
 
 // ----------------------------------------------------------------------------
@@ -24,6 +29,7 @@ NodeItem::NodeItem(NodeScene &scene, const NodeID &node)
     setFlags(QGraphicsItem::ItemIsMovable |
              QGraphicsItem::ItemIsFocusable |
              QGraphicsItem::ItemIsSelectable |
+             QGraphicsItem::ItemSendsGeometryChanges |
              QGraphicsItem::ItemSendsScenePositionChanges |
              QGraphicsItem::ItemContainsChildrenInShape);
 
@@ -41,7 +47,8 @@ QVariant NodeItem::itemChange(GraphicsItemChange change, const QVariant &value)
             return pos();
         return mScene.grid().snapAt(value.toPointF(), false);
     case ItemPositionHasChanged:
-        scene().nodeMoved(this);
+        if (QGraphicsItem::scene())
+            scene().nodeMoved(this);
         break;
     default:
         break;
@@ -53,9 +60,32 @@ QVariant NodeItem::itemChange(GraphicsItemChange change, const QVariant &value)
 
 QRectF NodeItem::boundingRect() const
 {
-    // TODO: cache this or make pos / size direct members?
-    auto size = model()->nodeData(node(), DataRole::Size).toSizeF();
-    return QRectF(QPointF(0, 0), size);
+    if (!mBoundsValid)
+    {
+        mBounds = QRectF(QPointF(0, 0), model()->nodeSize(node()));
+        mBoundsValid = true;
+    }
+
+    return mBounds;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeItem::invalidateGeometry()
+{
+    prepareGeometryChange();
+    mBoundsValid = false;
+    mPortTable.valid = false;
+    mBodyCache.pixmap = QPixmap();
+    mScene.portIndex().invalidate(this);
+    update();
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeItem::invalidateCaption()
+{
+    invalidateBodyCache();
 }
 
 // ----------------------------------------------------------------------------
@@ -65,27 +95,130 @@ void NodeItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
     Q_UNUSED(option);
     Q_UNUSED(widget);
 
-    if (scene().model())
+    if (!scene().model())
+        return;
+
+    auto lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    mDetailLevel = scene().detailLevel(lod);
+
+    if (mDetailLevel == DetailLevel::Low)
+        drawLowDetail(*painter);
+    else
+    if (mBodyCacheEnabled)
+        drawCached(*painter, zoomBucket(lod));
+    else
         draw(*painter);
 }
 
 // ----------------------------------------------------------------------------
 
+void NodeItem::setBodyCacheEnabled(bool enabled)
+{
+    mBodyCacheEnabled = enabled;
+    invalidateBodyCache();
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeItem::invalidateBodyCache()
+{
+    mBodyCache.pixmap = QPixmap();
+    update();
+}
+
+// ----------------------------------------------------------------------------
+
+int NodeItem::zoomBucket(qreal lod)
+{
+    if (lod <= 0)
+        return 0;
+
+    // clamp to 1/16 .. 4 to keep pixmaps reasonably sized
+    return qBound(-8, int(std::round(std::log2(lod) * 2)), 4);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeItem::drawCached(QPainter &painter, int zoom_bucket)
+{
+    auto rc = boundingRect();
+    auto ratio = painter.device() ? painter.device()->devicePixelRatioF() : qreal(1);
+
+    if (mBodyCache.pixmap.isNull() ||
+        mBodyCache.zoom_bucket != zoom_bucket ||
+        mBodyCache.selected != isSelected() ||
+        mBodyCache.device_ratio != ratio ||
+        mBodyCache.detail != mDetailLevel)
+    {
+        auto scale = std::pow(qreal(2), zoom_bucket / qreal(2));
+        auto size = QSizeF(rc.size() * scale * ratio);
+        if (size.isEmpty())
+            return;
+
+        QPixmap pixmap(int(std::ceil(size.width())), int(std::ceil(size.height())));
+        pixmap.setDevicePixelRatio(ratio);
+        pixmap.fill(Qt::transparent);
+
+        QPainter pixmap_painter(&pixmap);
+        pixmap_painter.scale(scale, scale);
+        pixmap_painter.translate(-rc.topLeft());
+        draw(pixmap_painter);
+        pixmap_painter.end();
+
+        mBodyCache = { pixmap, zoom_bucket, isSelected(), ratio, mDetailLevel };
+    }
+
+    painter.drawPixmap(rc, mBodyCache.pixmap, QRectF(mBodyCache.pixmap.rect()));
+}
+
+// ----------------------------------------------------------------------------
+
 int NodeItem::portCount(Direction direction) const
 {
-    int count = forAllPorts(direction, [] (const PortID &, int) {
-        return true;
-    });
-    return count < 0 ? 0 : count;
+    return portTable().counts[int(direction)];
 }
 
 // ----------------------------------------------------------------------------
 
 int NodeItem::portIndex(const PortID &port, Direction direction) const
 {
-    return forAllPorts(direction, [&port] (const PortID &id, int) -> bool {
-        return (id == port) ? false : true;
-    });
+    auto entry = portEntry(port);
+    if (entry < 0)
+        return -1;
+
+    auto &e = mPortTable.ports[entry];
+    return e.direction == direction ? e.index : -1;
+}
+
+// ----------------------------------------------------------------------------
+
+const NodeItem::PortTable &NodeItem::portTable() const
+{
+    if (mPortTable.valid)
+        return mPortTable;
+
+    mPortTable.ports.clear();
+    mPortTable.lookup.clear();
+    mPortTable.counts[0] = mPortTable.counts[1] = 0;
+
+    for (auto &port : model()->ports(node()))
+    {
+        auto direction = model()->portDirection(node(), port);
+        auto &count = mPortTable.counts[int(direction)];
+
+        mPortTable.lookup.insert(port.value, mPortTable.ports.size());
+        mPortTable.ports.append({ port, direction, count++ });
+    }
+
+    mPortTable.valid = true;
+    return mPortTable;
+}
+
+// ----------------------------------------------------------------------------
+
+int NodeItem::portEntry(const PortID &port) const
+{
+    return portTable().lookup.value(port.value, -1);
 }
 
 // ----------------------------------------------------------------------------
@@ -7,6 +7,9 @@
 // ----------------------------------------------------------------------------
 
 #include <QGraphicsItem>
+#include <QHash>
+#include <QPixmap>
+#include <QVector>
 
 // ----------------------------------------------------------------------------
 
@@ -26,6 +29,22 @@ public:
 
     enum { Type = UserType + 1 };
 
+    struct PortEntry
+    {
+        PortID                  id;
+        Direction               direction;
+        int                     index;      // index within direction
+    };
+
+    /// Ports of the node in model order, built once per port set change.
+    struct PortTable
+    {
+        bool                    valid = false;
+        QVector<PortEntry>      ports;
+        QHash<QUuid, int>       lookup;     // port ID -> index into ports
+        int                     counts[2] = { 0, 0 };
+    };
+
     NodeItem(NodeScene &scene, const NodeID &node);
 
     NodeScene                   &scene() { return mScene; }
@@ -42,6 +61,40 @@ public:
 
     virtual void                draw(QPainter &painter)=0;
 
+    /** Draws the item when zoomed out far.
+     *
+     * Called instead of draw() for DetailLevel::Low, implementations should
+     * skip text, ports and antialiasing.
+     *
+     */
+    virtual void                drawLowDetail(QPainter &painter)=0;
+
+    /// Level of detail of the current paint, valid during draw().
+    DetailLevel                 detailLevel() const { return mDetailLevel; }
+
+    /** Enables caching the rendered node body in a pixmap.
+     *
+     * The output of draw() is rendered once per zoom bucket, selection state
+     * and device pixel ratio and reused by later paints. The scene drops the
+     * cache when the model reports data changes for the node or its ports.
+     * Nodes which paint dynamic content must call invalidateBodyCache().
+     *
+     * Don't combine this with QGraphicsItem::setCacheMode(). Qt's item cache
+     * is thrown away on every update() of the item; ItemCoordinateCache
+     * scales a single pixmap when zooming and DeviceCoordinateCache is
+     * rebuilt for every transformation change. The body cache keeps one
+     * sharp pixmap per zoom bucket instead and only repaints on data changes.
+     *
+     */
+    void                        setBodyCacheEnabled(bool enabled);
+
+    bool                        isBodyCacheEnabled() const { return mBodyCacheEnabled; }
+
+    void                        invalidateBodyCache();
+
+    /// Maps a level of detail to a zoom bucket, buckets are half an octave wide.
+    static int                  zoomBucket(qreal lod);
+
     virtual PortID              portAt(const QPointF &pos) const=0;
 
     virtual QRectF              portRect(const QRectF &rc, const PortID &port) const=0;
@@ -50,6 +103,19 @@ public:
 
     virtual void                updateGrid()=0;
 
+    /** Drops cached geometry.
+     *
+     * Called by the scene when the node size or its ports changed. Derived
+     * classes caching geometry must call the base implementation.
+     *
+     */
+    virtual void                invalidateGeometry();
+
+    /// Called by the scene when the node's Display or Name role changed.
+    virtual void                invalidateCaption();
+
+    const PortTable             &portTable() const;
+
     /* QGraphicsItem */
 
     int                         type() const override { return Type; }
@@ -69,10 +135,31 @@ protected:
 
     int                         portIndex(const PortID &port, Direction direction) const;
 
+    /// Returns the position of a port in portTable() or -1.
+    int                         portEntry(const PortID &port) const;
+
 private:
 
     NodeScene                   &mScene;
     NodeID                      mNode;
+    DetailLevel                 mDetailLevel = DetailLevel::Full;
+    mutable QRectF              mBounds;
+    mutable bool                mBoundsValid = false;
+    mutable PortTable           mPortTable;
+
+    struct BodyCache
+    {
+        QPixmap                 pixmap;
+        int                     zoom_bucket;
+        bool                    selected;
+        qreal                   device_ratio;
+        DetailLevel             detail;
+    };
+
+    bool                        mBodyCacheEnabled = false;
+    BodyCache                   mBodyCache;
+
+    void                        drawCached(QPainter &painter, int zoom_bucket);
 };
 
 // ----------------------------------------------------------------------------
@@ -80,15 +167,12 @@ private:
 template<typename F>
 inline int NodeItem::forAllPorts(Direction direction, F f) const
 {
-    int index = 0;
-    for (auto it=model()->firstPort(node()), end=model()->endPort(node()); it!=end; it.next())
+    for (auto &entry : portTable().ports)
     {
-        if (model()->portDirection(it.node(), it.port()) == direction)
+        if (entry.direction == direction)
         {
-            if (!f(it.port(), index))
-                return index;
-
-            index++;
+            if (!f(entry.id, entry.index))
+                return entry.index;
         }
     }
     return -1;
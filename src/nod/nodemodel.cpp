@@ -1,4 +1,11 @@
 
+// ----------------------------------------------------------------------------
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+
+
 // ----------------------------------------------------------------------------
 
 #include "nod/nodemodel.h"
@@ -16,6 +23,28 @@ NodeModel::NodeModel(QObject *parent)
 
 // ----------------------------------------------------------------------------
 
+bool NodeModel::ChangeSet::isEmpty() const
+{
+    return created_nodes.isEmpty() && deleted_nodes.isEmpty() &&
+           connected.isEmpty() && disconnected.isEmpty() &&
+           ports_changed.isEmpty() && node_data.isEmpty() && port_data.isEmpty();
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::ChangeSet::clear()
+{
+    created_nodes.clear();
+    deleted_nodes.clear();
+    connected.clear();
+    disconnected.clear();
+    ports_changed.clear();
+    node_data.clear();
+    port_data.clear();
+}
+
+// ----------------------------------------------------------------------------
+
 const char *NodeModel::roleName(DataRole role) const
 {
     switch (role)
@@ -68,6 +97,410 @@ QString NodeModel::roleDisplayName(DataRole role) const
 
 // ----------------------------------------------------------------------------
 
+NodeModel::RoleMask NodeModel::rolesBelow(int max)
+{
+    if (max <= 0)
+        return 0;
+
+    if (max >= int(DataRole::User))
+        return ~RoleMask(0);
+
+    return (RoleMask(1) << max) - 1;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::setPortData(const NodeID &node, const PortID &port, const QVariant &value, DataRole role)
+{
+    Q_UNUSED(node);
+    Q_UNUSED(port);
+    Q_UNUSED(value);
+    Q_UNUSED(role);
+}
+
+// ----------------------------------------------------------------------------
+
+bool NodeModel::deleteNode(const NodeID &node)
+{
+    Q_UNUSED(node);
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+
+int NodeModel::connectAll(const QVector<Connection> &connections)
+{
+    int count = 0;
+    for (auto &c : connections)
+    {
+        if (connect(c.node1, c.port1, c.node2, c.port2))
+            ++count;
+    }
+
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+
+QPointF NodeModel::nodePosition(const NodeID &node) const
+{
+    return nodeData(node, DataRole::Position).toPointF();
+}
+
+// ----------------------------------------------------------------------------
+
+QSizeF NodeModel::nodeSize(const NodeID &node) const
+{
+    return nodeData(node, DataRole::Size).toSizeF();
+}
+
+// ----------------------------------------------------------------------------
+
+QRectF NodeModel::nodeGeometry(const NodeID &node) const
+{
+    return QRectF(nodePosition(node), nodeSize(node));
+}
+
+// ----------------------------------------------------------------------------
+
+QString NodeModel::nodeCaption(const NodeID &node) const
+{
+    auto caption = nodeData(node, DataRole::Display);
+    if (caption.isNull())
+        caption = nodeData(node, DataRole::Name);
+
+    return caption.toString();
+}
+
+// ----------------------------------------------------------------------------
+
+QString NodeModel::portCaption(const NodeID &node, const PortID &port) const
+{
+    auto caption = portData(node, port, DataRole::Display);
+    if (caption.isNull())
+        caption = portData(node, port, DataRole::Name);
+
+    return caption.toString();
+}
+
+// ----------------------------------------------------------------------------
+
+QColor NodeModel::portColor(const NodeID &node, const PortID &port) const
+{
+    auto color = portData(node, port, DataRole::Color);
+    if (!color.isValid())
+        return QColor();
+
+    return qvariant_cast<QColor>(color);
+}
+
+// ----------------------------------------------------------------------------
+
+NodeModel::RoleMask NodeModel::nodeRoles(const NodeID &node, RoleMask roles) const
+{
+    RoleMask result = 0;
+    for (; roles; roles &= roles - 1)
+    {
+        auto role = DataRole(qCountTrailingZeroBits(roles));
+        if (!nodeData(node, role).isNull())
+            result |= roleBit(role);
+    }
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+
+NodeModel::RoleMask NodeModel::portRoles(const NodeID &node, const PortID &port, RoleMask roles) const
+{
+    RoleMask result = 0;
+    for (; roles; roles &= roles - 1)
+    {
+        auto role = DataRole(qCountTrailingZeroBits(roles));
+        if (!portData(node, port, role).isNull())
+            result |= roleBit(role);
+    }
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::nodeRoleValues(const NodeID &node, RoleMask roles, RoleValues &values) const
+{
+    for (; roles; roles &= roles - 1)
+    {
+        auto role = DataRole(qCountTrailingZeroBits(roles));
+        auto value = nodeData(node, role);
+        if (!value.isNull())
+            values.append({ role, value });
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::portRoleValues(const NodeID &node, const PortID &port, RoleMask roles, RoleValues &values) const
+{
+    for (; roles; roles &= roles - 1)
+    {
+        auto role = DataRole(qCountTrailingZeroBits(roles));
+        auto value = portData(node, port, role);
+        if (!value.isNull())
+            values.append({ role, value });
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::endUpdate()
+{
+    Q_ASSERT(mUpdate > 0);
+    if (--mUpdate > 0)
+        return;
+
+    ChangeSet changes;
+    std::swap(changes, mChanges);
+    if (mPurge)
+        purgeChanges(changes);
+
+    mCreatedNodes.clear();
+    mDeletedNodes.clear();
+    mConnected.clear();
+    mDisconnected.clear();
+    mPortsChanged.clear();
+    mNodeDataKeys.clear();
+    mPortDataKeys.clear();
+    mPurge = false;
+
+    if (changes.isEmpty())
+        return;
+
+    // receivers may start and end updates of their own
+    auto emitting = mEmitting;
+    mEmitting = false;
+    emit modelChanged(*this, changes);
+
+    // listeners of the single signals see every change as well
+    mEmitting = true;
+    emitChanges(changes);
+    mEmitting = emitting;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::notifyNodeCreated(const NodeID &node)
+{
+    if (!isUpdating())
+    {
+        emit nodeCreated(*this, node);
+        return;
+    }
+
+    mDeletedNodes.remove(node.value);
+    mCreatedNodes.insert(node.value, mChanges.created_nodes.size());
+    mChanges.created_nodes.append(node);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::notifyNodeDeleted(const NodeID &node)
+{
+    if (!isUpdating())
+    {
+        emit nodeDeleted(*this, node);
+        return;
+    }
+
+    // the node's other changes are dropped by endUpdate()
+    mDeletedNodes.insert(node.value);
+    mPurge = true;
+
+    auto it = mCreatedNodes.find(node.value);
+    if (it != mCreatedNodes.end())
+    {
+        mChanges.created_nodes[*it] = NodeID::invalid();
+        mCreatedNodes.erase(it);
+    } else
+        mChanges.deleted_nodes.append(node);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::notifyConnected(const Connection &connection)
+{
+    if (!isUpdating())
+    {
+        emit nodeConnected(*this, connection.node1, connection.port1);
+        emit nodeConnected(*this, connection.node2, connection.port2);
+        return;
+    }
+
+    auto it = mDisconnected.find(connection);
+    if (it != mDisconnected.end())
+    {
+        mChanges.disconnected[*it] = Connection::invalid();
+        mDisconnected.erase(it);
+        mPurge = true;
+        return;
+    }
+
+    mConnected.insert(connection, mChanges.connected.size());
+    mChanges.connected.append(connection);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::notifyDisconnected(const Connection &connection)
+{
+    if (!isUpdating())
+    {
+        emit portDisconnected(*this, connection.node1, connection.port1);
+        emit portDisconnected(*this, connection.node2, connection.port2);
+        return;
+    }
+
+    auto it = mConnected.find(connection);
+    if (it != mConnected.end())
+    {
+        mChanges.connected[*it] = Connection::invalid();
+        mConnected.erase(it);
+        mPurge = true;
+        return;
+    }
+
+    mDisconnected.insert(connection, mChanges.disconnected.size());
+    mChanges.disconnected.append(connection);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::notifyPortsChanged(const NodeID &node)
+{
+    if (!isUpdating())
+    {
+        emit portsChanged(*this, node);
+        return;
+    }
+
+    if (!mPortsChanged.contains(node.value))
+    {
+        mPortsChanged.insert(node.value);
+        mChanges.ports_changed.append(node);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::notifyNodeDataChanged(const NodeID &node, DataRole role)
+{
+    if (!isUpdating())
+    {
+        emitNodeDataChanged(node, role);
+        return;
+    }
+
+    if (!mNodeDataKeys.contains({ node.value, int(role) }))
+    {
+        mNodeDataKeys.insert({ node.value, int(role) });
+        mChanges.node_data.append({ node, role });
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::notifyPortDataChanged(const NodeID &node, const PortID &port, DataRole role)
+{
+    if (!isUpdating())
+    {
+        emit portDataChanged(*this, node, port, role);
+        return;
+    }
+
+    // port IDs are unique across nodes
+    if (!mPortDataKeys.contains({ port.value, int(role) }))
+    {
+        mPortDataKeys.insert({ port.value, int(role) });
+        mChanges.port_data.append({ node, port, role });
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::purgeChanges(ChangeSet &changes) const
+{
+    auto dropNode = [this] (const NodeID &node) {
+        return !node.isValid() || mDeletedNodes.contains(node.value);
+    };
+
+    auto dropConnection = [this] (const Connection &c) {
+        return !c.isValid() || mDeletedNodes.contains(c.node1.value) || mDeletedNodes.contains(c.node2.value);
+    };
+
+    auto &created = changes.created_nodes;
+    created.erase(std::remove_if(created.begin(), created.end(), [] (const NodeID &node) { return !node.isValid(); }), created.end());
+
+    auto &connected = changes.connected;
+    connected.erase(std::remove_if(connected.begin(), connected.end(), dropConnection), connected.end());
+
+    // disconnections of deleted nodes must still be emitted
+    auto &disconnected = changes.disconnected;
+    disconnected.erase(std::remove_if(disconnected.begin(), disconnected.end(), [] (const Connection &c) { return !c.isValid(); }), disconnected.end());
+
+    auto &ports = changes.ports_changed;
+    ports.erase(std::remove_if(ports.begin(), ports.end(), dropNode), ports.end());
+
+    auto &node_data = changes.node_data;
+    node_data.erase(std::remove_if(node_data.begin(), node_data.end(), [&] (const NodeDataChange &c) { return dropNode(c.node); }), node_data.end());
+
+    auto &port_data = changes.port_data;
+    port_data.erase(std::remove_if(port_data.begin(), port_data.end(), [&] (const PortDataChange &c) { return dropNode(c.node); }), port_data.end());
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::emitChanges(const ChangeSet &changes)
+{
+    for (auto &c : changes.disconnected)
+    {
+        emit portDisconnected(*this, c.node1, c.port1);
+        emit portDisconnected(*this, c.node2, c.port2);
+    }
+
+    for (auto &node : changes.deleted_nodes)
+        emit nodeDeleted(*this, node);
+
+    for (auto &node : changes.created_nodes)
+        emit nodeCreated(*this, node);
+
+    for (auto &c : changes.connected)
+    {
+        emit nodeConnected(*this, c.node1, c.port1);
+        emit nodeConnected(*this, c.node2, c.port2);
+    }
+
+    for (auto &node : changes.ports_changed)
+        emit portsChanged(*this, node);
+
+    for (auto &change : changes.node_data)
+        emitNodeDataChanged(change.node, change.role);
+
+    for (auto &change : changes.port_data)
+        emit portDataChanged(*this, change.node, change.port, change.role);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeModel::emitNodeDataChanged(const NodeID &node, DataRole role)
+{
+    emit nodeDataChanged(*this, node, role);
+
+    if (role == DataRole::Position)
+        emit nodePositionChanged(*this, node);
+    else
+    if (role == DataRole::Size)
+        emit nodeSizeChanged(*this, node);
+}
+
+// ----------------------------------------------------------------------------
+
 } // namespace nod
 
 // ----------------------------------------------------------------------------
@@ -6,6 +6,14 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QColor>
+#include <QHash>
+#include <QSet>
+#include <QVarLengthArray>
+#include <QVector>
+
+// ----------------------------------------------------------------------------
+
 #include "nod/common.h"
 
 // ----------------------------------------------------------------------------
@@ -104,6 +112,112 @@ inline bool operator!=(const PortIt &a, const PortIt &b)
     return !operator==(a, b);
 }
 
+// ----------------------------------------------------------------------------
+// IDSpan
+// ----------------------------------------------------------------------------
+
+/** Contiguous storage of IDs a model can expose for iteration.
+ *
+ * The IDs may be members of larger records, stride is the record size.
+ * A default constructed span is invalid, meaning the model has no such
+ * storage.
+ *
+ */
+template <typename T>
+struct IDSpan
+{
+    const char                  *data = nullptr;
+    int                         count = -1;
+    int                         stride = int(sizeof(T));
+
+    bool                        isValid() const { return count >= 0; }
+
+    const T                     &operator[](int i) const { return *reinterpret_cast<const T *>(data + i * stride); }
+
+    /// Creates a span over a member of consecutive records.
+    template <typename R>
+    static IDSpan<T>            fromRecords(const R *records, int count, T R::*member)
+    {
+        return { count > 0 ? reinterpret_cast<const char *>(&(records->*member)) : nullptr, count, int(sizeof(R)) };
+    }
+};
+
+using NodeSpan          = IDSpan<NodeID>;
+using PortSpan          = IDSpan<PortID>;
+
+// ----------------------------------------------------------------------------
+// IDRange
+// ----------------------------------------------------------------------------
+
+inline const NodeID &iteratorValue(const NodeIt &it) { return it.node(); }
+
+inline const PortID &iteratorValue(const PortIt &it) { return it.port(); }
+
+// ----------------------------------------------------------------------------
+
+/** Range over node or port IDs, see NodeModel::nodes() and NodeModel::ports().
+ *
+ * Walks the model storage directly if the model provides an IDSpan and
+ * falls back to NodeIt / PortIt otherwise.
+ *
+ */
+template <typename T, typename It>
+class IDRange
+{
+public:
+
+    class iterator
+    {
+    public:
+
+        iterator(const char *ptr, int stride, const It &it)
+            : mPtr(ptr),
+              mStride(stride),
+              mIt(it)
+        {
+        }
+
+        const T                 &operator*() const { return mStride ? *reinterpret_cast<const T *>(mPtr) : iteratorValue(mIt); }
+
+        iterator                &operator++()
+        {
+            if (mStride)
+                mPtr += mStride;
+            else
+                mIt.next();
+            return *this;
+        }
+
+        bool                    operator==(const iterator &other) const { return mStride ? mPtr == other.mPtr : mIt == other.mIt; }
+
+        bool                    operator!=(const iterator &other) const { return !operator==(other); }
+
+    private:
+
+        const char              *mPtr;
+        int                     mStride;    // 0 if iterating with mIt
+        It                      mIt;
+    };
+
+    IDRange(const iterator &begin, const iterator &end)
+        : mBegin(begin),
+          mEnd(end)
+    {
+    }
+
+    iterator                    begin() const { return mBegin; }
+
+    iterator                    end() const { return mEnd; }
+
+private:
+
+    iterator                    mBegin;
+    iterator                    mEnd;
+};
+
+using NodeRange         = IDRange<NodeID, NodeIt>;
+using PortRange         = IDRange<PortID, PortIt>;
+
 // ----------------------------------------------------------------------------
 
 /** Data model abstraction.
@@ -116,8 +230,82 @@ class NodeModel : public QObject
     Q_OBJECT
 public:
 
+    struct NodeDataChange
+    {
+        NodeID                  node;
+        DataRole                role;
+    };
+
+    struct PortDataChange
+    {
+        NodeID                  node;
+        PortID                  port;
+        DataRole                role;
+    };
+
+    /** Changes collected between beginUpdate() and endUpdate().
+     *
+     * Each element is listed once. Nodes created and deleted, or connections
+     * made and removed, within the same update are dropped, as are the port
+     * and data changes of nodes deleted within the update.
+     *
+     */
+    struct ChangeSet
+    {
+        QVector<NodeID>         created_nodes;
+        QVector<NodeID>         deleted_nodes;
+        QVector<Connection>     connected;
+        QVector<Connection>     disconnected;
+        QVector<NodeID>         ports_changed;
+        QVector<NodeDataChange> node_data;
+        QVector<PortDataChange> port_data;
+
+        bool                    isEmpty() const;
+
+        void                    clear();
+    };
+
+    /// Bit n is set for DataRole n, only roles below DataRole::User fit.
+    using RoleMask = quint64;
+
+    struct RoleValue
+    {
+        DataRole                role;
+        QVariant                value;
+    };
+
+    using RoleValues = QVarLengthArray<RoleValue, 8>;
+
     NodeModel(QObject *parent=nullptr);
 
+    static RoleMask             roleBit(DataRole role) { return RoleMask(1) << int(role); }
+
+    /// Mask of all roles below @a max.
+    static RoleMask             rolesBelow(int max);
+
+    /* Updates */
+
+    /** Starts collecting change notifications.
+     *
+     * Until the matching endUpdate() the notify functions only record changes,
+     * endUpdate() then emits them as a single modelChanged() signal followed
+     * by the single change signals. Calls may be nested.
+     *
+     */
+    void                        beginUpdate() { ++mUpdate; }
+
+    void                        endUpdate();
+
+    bool                        isUpdating() const { return mUpdate > 0; }
+
+    /** Returns true while endUpdate() emits the single change signals.
+     *
+     * Receivers connected to modelChanged() and the single signals already
+     * handled these changes and skip them.
+     *
+     */
+    bool                        isEmittingChanges() const { return mEmitting; }
+
     /* Roles */
 
     virtual const char          *roleName(DataRole role) const;
@@ -136,6 +324,70 @@ public:
 
     virtual void                nextNode(NodeIt &it) const=0;
 
+    /** Deletes a node and its connections, e.g. to undo pasting it.
+     *
+     * Nodes are created through a NodeFactory, deleting is optional.
+     *
+     * @return False if the model doesn't support deleting, the default.
+     *
+     */
+    virtual bool                deleteNode(const NodeID &node);
+
+    /// Storage of the node IDs used by nodes(), the default is invalid.
+    virtual NodeSpan            nodeSpan() const { return NodeSpan(); }
+
+    /// Range over all nodes, for use in range-based for loops.
+    NodeRange                   nodes() const;
+
+    /* Typed access
+     *
+     * Used by the scene in paint and layout code. The default implementations
+     * go through nodeData() and portData(), models should override them to
+     * return their data directly.
+     */
+
+    /// DataRole::Position
+    virtual QPointF             nodePosition(const NodeID &node) const;
+
+    /// DataRole::Size
+    virtual QSizeF              nodeSize(const NodeID &node) const;
+
+    /// Position and size.
+    virtual QRectF              nodeGeometry(const NodeID &node) const;
+
+    /// DataRole::Display or DataRole::Name if there is no display value.
+    virtual QString             nodeCaption(const NodeID &node) const;
+
+    /// DataRole::Display or DataRole::Name if there is no display value.
+    virtual QString             portCaption(const NodeID &node, const PortID &port) const;
+
+    /// DataRole::Color, an invalid color if not set.
+    virtual QColor              portColor(const NodeID &node, const PortID &port) const;
+
+    /* Bulk access
+     *
+     * The defaults query each role in the mask, models storing their data
+     * per node should override them to skip unset roles.
+     */
+
+    /// Returns which of the given roles have a value for a node.
+    virtual RoleMask            nodeRoles(const NodeID &node, RoleMask roles) const;
+
+    /// Returns which of the given roles have a value for a port.
+    virtual RoleMask            portRoles(const NodeID &node, const PortID &port, RoleMask roles) const;
+
+    /** Appends the values of the given roles a node has a value for.
+     *
+     * @param node The node to query.
+     * @param roles The roles to return, unset roles are skipped.
+     * @param values Receives the values ordered by role.
+     *
+     */
+    virtual void                nodeRoleValues(const NodeID &node, RoleMask roles, RoleValues &values) const;
+
+    /// Appends the values of the given roles a port has a value for.
+    virtual void                portRoleValues(const NodeID &node, const PortID &port, RoleMask roles, RoleValues &values) const;
+
     /* Ports */
 
     virtual PortIt              firstPort(const NodeID &node) const=0;
@@ -144,10 +396,19 @@ public:
 
     virtual void                nextPort(PortIt &it) const=0;
 
+    /// Storage of the port IDs of a node used by ports(), the default is invalid.
+    virtual PortSpan            portSpan(const NodeID &node) const { Q_UNUSED(node); return PortSpan(); }
+
+    /// Range over the ports of a node, for use in range-based for loops.
+    PortRange                   ports(const NodeID &node) const;
+
     virtual QVariant            portData(const NodeID &node, const PortID &port, DataRole role) const=0;
 
     virtual Direction           portDirection(const NodeID &node, const PortID &port) const=0;
 
+    /// Sets port data when restoring a model, the default ignores it.
+    virtual void                setPortData(const NodeID &node, const PortID &port, const QVariant &value, DataRole role);
+
     /* Connections */
 
     virtual NodeID              connectedNode(const NodeID &node, const PortID &port, PortID *other_port=nullptr) const=0;
@@ -162,6 +423,16 @@ public:
     virtual bool                connect(const NodeID &node1, const PortID &port1,
                                         const NodeID &node2, const PortID &port2)=0;
 
+    /** Makes a batch of connections, e.g. when loading.
+     *
+     * Connections that can't be made are skipped. The default calls connect()
+     * for each, models override it to check for duplicates once per batch.
+     *
+     * @return The number of connections made.
+     *
+     */
+    virtual int                 connectAll(const QVector<Connection> &connections);
+
     virtual bool                disconnect(const NodeID &node)=0;
 
     virtual bool                disconnect(const NodeID &node, const PortID &port)=0;
@@ -188,17 +459,82 @@ signals:
 
     void                        nodeDeleted(NodeModel &model, const NodeID &node);
 
+    /// Emitted after nodeDataChanged() for DataRole::Position.
     void                        nodePositionChanged(NodeModel &model, const NodeID &node);
 
+    /// Emitted after nodeDataChanged() for DataRole::Size.
     void                        nodeSizeChanged(NodeModel &model, const NodeID &node);
 
+    /// Emitted after ports were added to or removed from a node, see notifyPortsChanged().
+    void                        portsChanged(NodeModel &model, const NodeID &node);
+
+    void                        nodeDataChanged(NodeModel &model, const NodeID &node, DataRole role);
+
+    void                        portDataChanged(NodeModel &model, const NodeID &node, const PortID &port, DataRole role);
+
     void                        nodeConnected(NodeModel &model, const NodeID &node, const PortID &port);
 
     void                        nodeDisconnected(NodeModel &model, const NodeID &node);
 
     void                        portDisconnected(NodeModel &model, const NodeID &node, const PortID &port);
 
+    /** Emitted by endUpdate() with all changes made during the update.
+     *
+     * The single change signals for the same changes follow, see
+     * isEmittingChanges().
+     *
+     */
+    void                        modelChanged(NodeModel &model, const ChangeSet &changes);
+
+    /** Emitted when the contents of the model were replaced as a whole.
+     *
+     * Sent instead of a change per node, e.g. when a file was opened. Views
+     * drop what they know about the model and read the nodes they need again.
+     * Not collected by beginUpdate().
+     *
+     */
+    void                        modelReset(NodeModel &model);
+
+protected:
+
+    /* Notifications, emit the change signals or record them during an update.
+     * Subclasses may override them to observe every change, they must call
+     * the base implementation. AbstractNodeModel seals them for its journal,
+     * its subclasses connect to the change signals instead. */
+
+    virtual void                notifyNodeCreated(const NodeID &node);
+
+    virtual void                notifyNodeDeleted(const NodeID &node);
+
+    virtual void                notifyConnected(const Connection &connection);
+
+    virtual void                notifyDisconnected(const Connection &connection);
+
+    virtual void                notifyPortsChanged(const NodeID &node);
+
+    virtual void                notifyNodeDataChanged(const NodeID &node, DataRole role);
+
+    virtual void                notifyPortDataChanged(const NodeID &node, const PortID &port, DataRole role);
+
 private:
+
+    int                         mUpdate = 0;
+    ChangeSet                   mChanges;
+    QHash<QUuid, int>           mCreatedNodes;      // index in mChanges.created_nodes
+    QSet<QUuid>                 mDeletedNodes;      // deleted during the update
+    QHash<Connection, int>      mConnected;         // index in mChanges.connected
+    QHash<Connection, int>      mDisconnected;      // index in mChanges.disconnected
+    QSet<QUuid>                 mPortsChanged;
+    QSet<QPair<QUuid, int>>     mNodeDataKeys;
+    QSet<QPair<QUuid, int>>     mPortDataKeys;
+    bool                        mPurge = false;     // mChanges has dropped entries
+    bool                        mEmitting = false;  // see isEmittingChanges()
+
+    void                        purgeChanges(ChangeSet &changes) const;
+
+    void                        emitChanges(const ChangeSet &changes);
+
+    void                        emitNodeDataChanged(const NodeID &node, DataRole role);
 };
 
 // ----------------------------------------------------------------------------
@@ -267,6 +603,40 @@ inline void PortIt::next()
 
 // ----------------------------------------------------------------------------
 
+inline NodeRange NodeModel::nodes() const
+{
+    auto &model = const_cast<NodeModel &>(*this);
+
+    auto span = nodeSpan();
+    if (span.isValid())
+    {
+        NodeIt none(model, NodeID::invalid(), 0);
+        return { { span.data, span.stride, none },
+                 { span.data + span.count * span.stride, span.stride, none } };
+    }
+
+    return { { nullptr, 0, firstNode() }, { nullptr, 0, endNode() } };
+}
+
+// ----------------------------------------------------------------------------
+
+inline PortRange NodeModel::ports(const NodeID &node) const
+{
+    auto &model = const_cast<NodeModel &>(*this);
+
+    auto span = portSpan(node);
+    if (span.isValid())
+    {
+        PortIt none(model, node, 0, PortID::invalid(), 0);
+        return { { span.data, span.stride, none },
+                 { span.data + span.count * span.stride, span.stride, none } };
+    }
+
+    return { { nullptr, 0, firstPort(node) }, { nullptr, 0, endPort(node) } };
+}
+
+// ----------------------------------------------------------------------------
+
 } // namespace nod
 
 // ----------------------------------------------------------------------------
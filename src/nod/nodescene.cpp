@@ -30,6 +30,39 @@ NodeScene::NodeScene(NodeItemFactory &factory, QObject *parent)
 
     connect(this, &QGraphicsScene::sceneRectChanged,
             this, &NodeScene::sceneRectChanged);
+
+    mCreatePlanTimer.setSingleShot(true);
+    connect(&mCreatePlanTimer, &QTimer::timeout,
+            this, &NodeScene::planCreateConnection);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::setIncrementalPlanning(bool enable)
+{
+    mGrid.planner().setMode(enable ? PathPlanner::Mode::Incremental : PathPlanner::Mode::Full);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::setDetailThresholds(qreal low, qreal medium)
+{
+    mLowDetailThreshold = low;
+    mMediumDetailThreshold = medium;
+    invalidate();
+}
+
+// ----------------------------------------------------------------------------
+
+DetailLevel NodeScene::detailLevel(qreal lod) const
+{
+    if (lod < mLowDetailThreshold)
+        return DetailLevel::Low;
+
+    if (lod < mMediumDetailThreshold)
+        return DetailLevel::Medium;
+
+    return DetailLevel::Full;
 }
 
 // ----------------------------------------------------------------------------
@@ -41,56 +74,66 @@ void NodeScene::setModel(NodeModel *model)
 
     mModel = model;
     mNodeItems.clear();
+    mNodeRects.clear();
+    mNodeBounds = QRectF();
+    mNodeBoundsValid = true;
+    mPortIndex.clear();
     mConnectionItems.clear();
 
     clear();
 
     if (mModel)
     {
+        beginBatch();
+
         connect(mModel, &NodeModel::destroyed, this, &NodeScene::modelDestroyed);
         connect(mModel, &NodeModel::nodeCreated, this, &NodeScene::nodeCreated);
         connect(mModel, &NodeModel::nodeDeleted, this, &NodeScene::nodeDeleted);
         connect(mModel, &NodeModel::nodeConnected, this, &NodeScene::nodeConnected);
         connect(mModel, &NodeModel::nodeDisconnected, this, &NodeScene::nodeDisconnected);
+        connect(mModel, &NodeModel::portsChanged, this, &NodeScene::portsChanged);
+        connect(mModel, &NodeModel::nodeDataChanged, this, &NodeScene::nodeDataChanged);
+        connect(mModel, &NodeModel::portDataChanged, this, &NodeScene::portDataChanged);
+        connect(mModel, &NodeModel::modelChanged, this, &NodeScene::modelChanged);
+        connect(mModel, &NodeModel::modelReset, this, &NodeScene::modelReset);
 
 
-        auto nit = mModel->firstNode();
-        while (!nit.atEnd())
-        {
-            auto node = nit.node();
+        for (auto &node : mModel->nodes())
             nodeCreated(*mModel, node);
-            nit.next();
-        }
 
-        nit = mModel->firstNode();
-        while (!nit.atEnd())
+        for (auto &node : mModel->nodes())
         {
-            auto node = nit.node();
+            for (auto &port : mModel->ports(node))
+                nodeConnected(*mModel, node, port);
+        }
 
-            auto pit = mModel->firstPort(node);
-            while (!pit.atEnd())
-            {
-                nodeConnected(*mModel, node, pit.port());
-                pit.next();
-            }
+        endBatch();
+    } else
+        updateSceneRect();
+}
 
-            nit.next();
-        }
-    }
+// ----------------------------------------------------------------------------
+
+void NodeScene::endBatch()
+{
+    Q_ASSERT(mBatch > 0);
+    if (--mBatch > 0)
+        return;
 
+    // a changed scene rect updates the grid and routes all connections
+    auto rc = sceneRect();
     updateSceneRect();
+    if (sceneRect() == rc)
+        mGrid.updateGrid();
+
+    invalidate();
 }
 
 // ----------------------------------------------------------------------------
 
 NodeItem *NodeScene::nodeItem(const NodeID &node)
 {
-    for (auto item : mNodeItems)
-    {
-        if (item->node() == node)
-            return item;
-    }
-    return nullptr;
+    return mNodeItems.value(node.value);
 }
 
 // ----------------------------------------------------------------------------
@@ -105,11 +148,7 @@ NodeItem *NodeScene::itemAt(const QPointF &pt, PortID &port_id)
         auto node = qgraphicsitem_cast<NodeItem*>(item);
         if (node)
         {
-            auto position = node->mapFromScene(pt);
-            auto port = node->portAt(position);
-            if (port.isValid())
-                port_id = port;
-
+            port_id = mPortIndex.portAt(pt, node);
             return node;
         }
     }
@@ -121,10 +160,17 @@ NodeItem *NodeScene::itemAt(const QPointF &pt, PortID &port_id)
 
 void NodeScene::updateSceneRect()
 {
-    QRectF rc;
-    auto all = items();
-    for (auto item : all)
-        rc = rc.united(item->sceneBoundingRect());
+    if (!mNodeBoundsValid)
+    {
+        mNodeBounds = QRectF();
+        for (auto &node_rc : mNodeRects)
+            mNodeBounds = mNodeBounds.united(node_rc);
+
+        mNodeBoundsValid = true;
+    }
+
+    // connections are routed on the grid, which only spans the nodes
+    auto rc = mNodeBounds;
 
     auto gs = grid().gridSize();
     rc.adjust(-gs, -gs, gs, gs);
@@ -142,9 +188,21 @@ void NodeScene::nodeMoved(NodeItem *item)
 {
 //    qDebug() << "NodeScene: node moved" << item;
 
-    // TODO: maintiain damage area, add item, partial grid update, partial invalidate
-    mGrid.updateGrid();
-    invalidate(sceneRect(), QGraphicsScene::ForegroundLayer);
+    auto old_rc = mNodeRects.value(item);
+    auto damage = updateNodeRect(item);
+    mPortIndex.invalidate(item);
+
+    if (mDragging)
+        mDraggedNodes.insert(item->node().value, item->node());
+
+    if (isBatching())
+        return;
+
+    // runs on every mouse move of a drag, only touch what the node covered
+    mGrid.updateNode(item, old_rc);
+
+    // the debug overlay shows the whole grid
+    invalidateDamage(mDebug ? sceneRect() : damage, QGraphicsScene::ForegroundLayer);
     updateSceneRect();
 }
 
@@ -157,8 +215,9 @@ bool NodeScene::beginCreateConnection(const QPointF &pt, const NodeID &node, con
     mCreateNode = node;
     mCreatePort = port;
     mCreateShape.reset(mFactory.createConnectionShape());
-
-    invalidate(sceneRect(), ForegroundLayer);
+    mCreateDamage = QRectF();
+    mCreatePlanned = false;
+    mCreatePlanTime.invalidate();
 
     return true;
 }
@@ -171,12 +230,48 @@ void NodeScene::updateCreateConnection(const QPointF &pt)
         return;
 
     auto sp = mGrid.snapAt(pt);
+    if (mCreatePlanned && sp == mCreateTarget)
+        return; // still in the same cell
+
+    mCreateTarget = sp;
     mCreateOffset = QPointF(mCreatePoint.x() < sp.x() ? mCreatePoint.x() : sp.x(),
                             mCreatePoint.y() < sp.y() ? mCreatePoint.y() : sp.y());
 
-    mCreateShape->updatePath(mCreatePoint, mGrid.snapAt(pt));
+    if (!mCreatePlanTime.isValid() || mCreatePlanTime.elapsed() >= mPreviewInterval)
+    {
+        mCreatePlanned = false;
+        planCreateConnection();
+        return;
+    }
 
-    invalidate(sceneRect(), ForegroundLayer);
+    // plan at most once per interval, show a straight line until then
+    mCreatePlanned = false;
+    mCreateShape->setStraightPath(mCreatePoint, sp);
+
+    if (!mCreatePlanTimer.isActive())
+        mCreatePlanTimer.start(qMax(0, mPreviewInterval - int(mCreatePlanTime.elapsed())));
+
+    auto rc = createConnectionBounds();
+    invalidateDamage(rc.united(mCreateDamage), ForegroundLayer);
+    mCreateDamage = rc;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::planCreateConnection()
+{
+    mCreatePlanTimer.stop();
+
+    if (!mCreateConnection || mCreatePlanned)
+        return;
+
+    mCreateShape->updatePath(mCreatePoint, mCreateTarget);
+    mCreatePlanned = true;
+    mCreatePlanTime.restart();
+
+    auto rc = createConnectionBounds();
+    invalidateDamage(rc.united(mCreateDamage), ForegroundLayer);
+    mCreateDamage = rc;
 }
 
 // ----------------------------------------------------------------------------
@@ -184,8 +279,10 @@ void NodeScene::updateCreateConnection(const QPointF &pt)
 bool NodeScene::endCreateConnection(const QPointF &pt, const Connection &connection)
 {
     mCreateConnection = false;
+    mCreatePlanTimer.stop();
 
-    invalidate(sceneRect(), ForegroundLayer);
+    invalidateDamage(mCreateDamage, ForegroundLayer);
+    mCreateDamage = QRectF();
 
     return true;
 }
@@ -200,7 +297,7 @@ void NodeScene::drawBackground(QPainter *painter, const QRectF &rect)
     painter->fillRect(rect, Qt::white);
 
     if (mDrawGrid)
-        mGrid.draw(*painter);
+        mGrid.draw(*painter, rect);
 }
 
 // ----------------------------------------------------------------------------
@@ -220,6 +317,93 @@ void NodeScene::drawForeground(QPainter *painter, const QRectF &rect)
         painter->drawRect(mCreateShape->boundingRect());
         painter->setTransform(old);
     }
+
+    if (mShowDamage)
+    {
+        painter->setPen(QPen(Qt::red, 0));
+        painter->setBrush(Qt::NoBrush);
+        for (auto &rc : mDamage)
+            painter->drawRect(rc);
+
+        mShownDamage += mDamage;
+        mDamage.clear();
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::invalidateDamage(const QRectF &rect, SceneLayers layers)
+{
+    if (rect.isEmpty())
+        return;
+
+    if (mShowDamage)
+    {
+        // erase the outlines of the previous paint
+        for (auto &rc : mShownDamage)
+            invalidate(rc, ForegroundLayer);
+
+        mShownDamage.clear();
+        mDamage.append(rect);
+    }
+
+    invalidate(rect, layers);
+}
+
+// ----------------------------------------------------------------------------
+
+QRectF NodeScene::createConnectionBounds() const
+{
+    if (!mCreateShape)
+        return QRectF();
+
+    // include the bounds outline drawn in drawForeground()
+    return mCreateShape->boundingRect().translated(mCreateOffset).adjusted(-2, -2, 2, 2);
+}
+
+// ----------------------------------------------------------------------------
+
+QRectF NodeScene::updateNodeRect(NodeItem *item)
+{
+    auto rc = item->sceneBoundingRect();
+    auto old_rc = mNodeRects.value(item);
+    mNodeRects[item] = rc;
+
+    trackNodeBounds(old_rc, rc);
+
+    return rc.united(old_rc);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::updateNodeGeometry(NodeItem *item)
+{
+    item->invalidateGeometry();
+
+    invalidateDamage(updateNodeRect(item), ForegroundLayer);
+    if (!isBatching())
+        updateSceneRect();
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::trackNodeBounds(const QRectF &old_rc, const QRectF &rc)
+{
+    if (!mNodeBoundsValid)
+        return;
+
+    // the bounds only need a recount if an extremal node shrinks or moves inward
+    if (!old_rc.isNull() &&
+        ((old_rc.left() <= mNodeBounds.left() && (rc.isNull() || rc.left() > old_rc.left())) ||
+         (old_rc.top() <= mNodeBounds.top() && (rc.isNull() || rc.top() > old_rc.top())) ||
+         (old_rc.right() >= mNodeBounds.right() && (rc.isNull() || rc.right() < old_rc.right())) ||
+         (old_rc.bottom() >= mNodeBounds.bottom() && (rc.isNull() || rc.bottom() < old_rc.bottom()))))
+    {
+        mNodeBoundsValid = false;
+        return;
+    }
+
+    mNodeBounds = mNodeBounds.united(rc);
 }
 
 // ----------------------------------------------------------------------------
@@ -231,44 +415,62 @@ void NodeScene::modelDestroyed()
 
 // ----------------------------------------------------------------------------
 
+void NodeScene::modelReset(NodeModel &model)
+{
+    setModel(&model);
+}
+
+// ----------------------------------------------------------------------------
+
 void NodeScene::nodeConnected(NodeModel &model, const NodeID &node, const PortID &port)
 {
-    Q_UNUSED(model);
+    // handled by modelChanged() already
+    if (model.isEmittingChanges())
+        return;
 
-    for (auto item : mConnectionItems)
+    for (auto it=mConnectionItems.constFind(port.value); it!=mConnectionItems.constEnd() && it.key()==port.value; ++it)
     {
-        if (item->connection().contains(node, port))
+        if ((*it)->connection().contains(node, port))
             return;
     }
 
     auto item = mFactory.createConnectionItem(node, port);
     if (item)
-        mConnectionItems.append(item);
+    {
+        mConnectionItems.insert(item->connection().port1.value, item);
+        mConnectionItems.insert(item->connection().port2.value, item);
+    }
 }
 
 // ----------------------------------------------------------------------------
 
 void NodeScene::nodeDisconnected(NodeModel &model, const NodeID &node)
 {
-    for (auto it=model.firstPort(node), end=model.endPort(node); it!=end; it.next())
-        portDisconnected(model, node, it.port());
+    // handled by modelChanged() already
+    if (model.isEmittingChanges())
+        return;
+
+    for (auto &port : model.ports(node))
+        portDisconnected(model, node, port);
 }
 
 // ----------------------------------------------------------------------------
 
 void NodeScene::portDisconnected(NodeModel &model, const NodeID &node, const PortID &port)
 {
-    for (auto it=mConnectionItems.begin(); it!=mConnectionItems.end(); )
-    {
-        auto c = (*it)->connection();
+    Q_UNUSED(model);
 
-        if (c.contains(node, port))
-        {
-            removeItem(*it);
-            delete *it;
-            it = mConnectionItems.erase(it);
-        } else
-            ++it;
+    auto items = mConnectionItems.values(port.value);
+    for (auto item : items)
+    {
+        auto c = item->connection();
+        if (!c.contains(node, port))
+            continue;
+
+        mConnectionItems.remove(c.port1.value, item);
+        mConnectionItems.remove(c.port2.value, item);
+        removeItem(item);
+        delete item;
     }
 }
 
@@ -276,57 +478,150 @@ void NodeScene::portDisconnected(NodeModel &model, const NodeID &node, const Por
 
 void NodeScene::nodeCreated(NodeModel &model, const NodeID &node)
 {
-    Q_UNUSED(model);
+    // handled by modelChanged() already
+    if (model.isEmittingChanges())
+        return;
 
-    for (auto item : mNodeItems)
-    {
-        if (item->node() == node)
-            return;
-    }
+    if (mNodeItems.contains(node.value))
+        return;
 
     auto item = mFactory.createNodeItem(node);
     if (item)
     {
-        auto pos = model.nodeData(node, DataRole::Position);
-        if (pos.isNull())
-            pos = QPointF(0, 0);
-
-        item->setPos(pos.toPointF());
+        item->setPos(model.nodePosition(node));
 
         auto size = model.nodeData(node, DataRole::Size);
         if (size.isNull())
         {
             size = item->calculateItemSize();
             model.setNodeData(node, size, DataRole::Size);
+            item->invalidateGeometry();
         }
 
         item->setVisible(true);
 
         addItem(item);
-        mNodeItems.append(item);
+        mNodeItems.insert(node.value, item);
+        updateNodeRect(item);
+        mPortIndex.invalidate(item);
     }
 
-    updateSceneRect();
+    if (!isBatching())
+        updateSceneRect();
 }
 
 // ----------------------------------------------------------------------------
 
 void NodeScene::nodeDeleted(NodeModel &model, const NodeID &node)
 {
-    Q_UNUSED(model);
+    // handled by modelChanged() already
+    if (model.isEmittingChanges())
+        return;
 
     nodeDisconnected(model, node);
 
-    for (auto it=mNodeItems.begin(); it!=mNodeItems.end(); ++it)
+    auto item = mNodeItems.take(node.value);
+    if (!item)
+        return;
+
+    auto rc = mNodeRects.take(item);
+    trackNodeBounds(rc, QRectF());
+    invalidateDamage(rc, AllLayers);
+    mPortIndex.remove(item);
+    removeItem(item);
+    delete item;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::portsChanged(NodeModel &model, const NodeID &node)
+{
+    // handled by modelChanged() already
+    if (model.isEmittingChanges())
+        return;
+
+    auto item = nodeItem(node);
+    if (item)
+        updateNodeGeometry(item);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::nodeDataChanged(NodeModel &model, const NodeID &node, DataRole role)
+{
+    // handled by modelChanged() already
+    if (model.isEmittingChanges())
+        return;
+
+    auto item = nodeItem(node);
+    if (!item)
+        return;
+
+    if (role == DataRole::Size)
+        updateNodeGeometry(item);
+    else
+    if (role == DataRole::Position)
+        item->setPos(model.nodePosition(node));
+    else
+    if (role == DataRole::Name || role == DataRole::Display)
+        item->invalidateCaption();
+    else
+        item->invalidateBodyCache();
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::portDataChanged(NodeModel &model, const NodeID &node, const PortID &port, DataRole role)
+{
+    // handled by modelChanged() already
+    if (model.isEmittingChanges())
+        return;
+
+    Q_UNUSED(port);
+
+    auto item = nodeItem(node);
+    if (!item)
+        return;
+
+    // labels are measured from the port name
+    if (role == DataRole::Name || role == DataRole::Display)
+        updateNodeGeometry(item);
+    else
+        item->invalidateBodyCache();
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeScene::modelChanged(NodeModel &model, const NodeModel::ChangeSet &changes)
+{
+    beginBatch();
+
+    for (auto &c : changes.disconnected)
     {
-        if ((*it)->node() == node)
-        {
-            removeItem(*it);
-            delete *it;
-            mNodeItems.erase(it);
-            break;
-        }
+        portDisconnected(model, c.node1, c.port1);
+        portDisconnected(model, c.node2, c.port2);
     }
+
+    for (auto &node : changes.deleted_nodes)
+        nodeDeleted(model, node);
+
+    for (auto &node : changes.created_nodes)
+        nodeCreated(model, node);
+
+    // one item per connection, the second endpoint would be a duplicate
+    for (auto &c : changes.connected)
+        nodeConnected(model, c.node1, c.port1);
+
+    for (auto &node : changes.ports_changed)
+        portsChanged(model, node);
+
+    for (auto &change : changes.node_data)
+        nodeDataChanged(model, change.node, change.role);
+
+    for (auto &change : changes.port_data)
+        portDataChanged(model, change.node, change.port, change.role);
+
+    endBatch();
 }
 
 // ----------------------------------------------------------------------------
@@ -342,9 +637,13 @@ void NodeScene::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
     QGraphicsScene::mouseMoveEvent(event);
 
     if (mCreateConnection)
-    {
         updateCreateConnection(event->scenePos());
-        invalidate(sceneRect(), QGraphicsScene::ForegroundLayer);
+
+    if (!mDraggedNodes.isEmpty())
+    {
+        auto nodes = mDraggedNodes.values().toVector();
+        mDraggedNodes.clear();
+        emit nodesMoved(nodes, mDragGesture);
     }
 }
 
@@ -355,6 +654,12 @@ void NodeScene::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
     QGraphicsScene::mousePressEvent(event);
 
+    if (event->button() == Qt::LeftButton)
+    {
+        mDragging = true;
+        ++mDragGesture;
+    }
+
     PortID port;
     auto item = itemAt(event->scenePos(), port);
     if (item && port.isValid())
@@ -388,6 +693,8 @@ void NodeScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
         mCreateConnection = false;
     }
 
+    mDragging = false;
+    mDraggedNodes.clear();
     mItemMoveEnabled = true;
 }
 
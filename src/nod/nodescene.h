@@ -6,13 +6,18 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QElapsedTimer>
 #include <QGraphicsScene>
+#include <QHash>
+#include <QTimer>
 #include <QVector>
 
 // ----------------------------------------------------------------------------
 
 #include "nod/connectionshape.h"
 #include "nod/nodegrid.h"
+#include "nod/nodemodel.h"
+#include "nod/portindex.h"
 
 // ----------------------------------------------------------------------------
 
@@ -35,24 +40,77 @@ public:
 
     bool                        isDebug() const { return mDebug; }
 
+    /// Outlines the regions invalidated by the scene, for debugging repaints.
+    void                        setShowDamage(bool show) { mShowDamage = show; invalidate(); }
+
+    bool                        showDamage() const { return mShowDamage; }
+
     void                        setDrawGrid(bool draw) { mDrawGrid = draw; invalidate(); }
 
     bool                        drawGrid() const { return mDrawGrid; }
 
+    /** Sets the zoom levels below which items are drawn with less detail.
+     *
+     * @param low Below this level of detail items are drawn as flat shapes.
+     * @param medium Below this level of detail text is omitted.
+     *
+     */
+    void                        setDetailThresholds(qreal low, qreal medium);
+
+    /// Maps a level of detail as returned by QStyleOptionGraphicsItem::levelOfDetailFromTransform().
+    DetailLevel                 detailLevel(qreal lod) const;
+
     NodeItemFactory             &itemFactory() { return mFactory; }
 
     NodeGrid                    &grid() { return mGrid; }
 
     const NodeGrid              &grid() const { return mGrid; }
 
+    /// Spatial index of the port rects, used by itemAt().
+    PortIndex                   &portIndex() { return mPortIndex; }
+
     bool                        isItemMoveEnabled() const { return mItemMoveEnabled; }
 
+    /** Sets the minimum time between path plans while creating a connection.
+     *
+     * Mouse moves in between show a straight preview, the final position is
+     * planned once the interval elapsed.
+     *
+     * @param msec The interval in milliseconds, 0 plans on every move.
+     *
+     */
+    void                        setPreviewInterval(int msec) { mPreviewInterval = msec; }
+
+    int                         previewInterval() const { return mPreviewInterval; }
+
+    /** Repairs connection paths incrementally instead of planning from scratch.
+     *
+     * Uses PathPlanner::Mode::Incremental, each connection then keeps two
+     * ints per grid cell. Disabled by default.
+     *
+     */
+    void                        setIncrementalPlanning(bool enable);
+
+    bool                        incrementalPlanning() const { return mGrid.planner().mode() == PathPlanner::Mode::Incremental; }
+
     NodeModel                   *model() { return mModel; }
 
     const NodeModel             *model() const { return mModel; }
 
     virtual void                setModel(NodeModel *model);
 
+    /** Defers scene rect, grid and routing updates until endBatch().
+     *
+     * Use this when creating many nodes and connections at once. Calls may
+     * be nested, the updates are done once by the outermost endBatch().
+     *
+     */
+    void                        beginBatch() { ++mBatch; }
+
+    void                        endBatch();
+
+    bool                        isBatching() const { return mBatch > 0; }
+
     NodeItem                    *nodeItem(const NodeID &node);
 
     NodeItem                    *itemAt(const QPointF &pt, PortID &port_id);
@@ -77,6 +135,15 @@ public:
 
     void                        mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 
+signals:
+
+    /** Emitted while dragging nodes, once per mouse move.
+     *
+     * All moves of one drag share the same @a gesture number.
+     *
+     */
+    void                        nodesMoved(const QVector<NodeID> &nodes, int gesture);
+
 public slots:
 
     virtual void                updateSceneRect();
@@ -95,18 +162,67 @@ protected slots:
 
     virtual void                nodeDeleted(NodeModel &model, const NodeID &node);
 
+    virtual void                portsChanged(NodeModel &model, const NodeID &node);
+
+    /// Size changes are reported as DataRole::Size and invalidate the item geometry.
+    virtual void                nodeDataChanged(NodeModel &model, const NodeID &node, DataRole role);
+
+    virtual void                portDataChanged(NodeModel &model, const NodeID &node, const PortID &port, DataRole role);
+
+    /// Applies the changes of a NodeModel update in one batch.
+    virtual void                modelChanged(NodeModel &model, const NodeModel::ChangeSet &changes);
+
+    /// Rebuilds all items, see NodeModel::modelReset().
+    virtual void                modelReset(NodeModel &model);
+
     virtual void                sceneRectChanged(const QRectF &rect);
 
+    /// Plans the path of the connection being created, see setPreviewInterval().
+    virtual void                planCreateConnection();
+
+protected:
+
+    /// Invalidates a region of the scene and records it for showDamage().
+    void                        invalidateDamage(const QRectF &rect, SceneLayers layers);
+
+    /// Returns the scene rect covered by the connection being created.
+    QRectF                      createConnectionBounds() const;
+
+    /** Records the scene rect of a node and updates the tracked node bounds.
+     *
+     * @return The union of the old and new rect, the area to repaint.
+     *
+     */
+    QRectF                      updateNodeRect(NodeItem *item);
+
+    /// Invalidates the geometry of a node after size or port changes.
+    void                        updateNodeGeometry(NodeItem *item);
+
 private:
 
+    void                        trackNodeBounds(const QRectF &old_rc, const QRectF &rc);
+
     NodeItemFactory             &mFactory;
     NodeGrid                    mGrid;
+    PortIndex                   mPortIndex;
     NodeModel                   *mModel = nullptr;
-    QVector<NodeItem *>         mNodeItems;
+    QHash<QUuid, NodeItem *>    mNodeItems;
+    QHash<NodeItem *, QRectF>   mNodeRects;     // last known scene rects
+    QRectF                      mNodeBounds;    // union of mNodeRects
+    bool                        mNodeBoundsValid = true;
     bool                        mItemMoveEnabled = true;
-    QVector<ConnectionItem *>   mConnectionItems;
+    bool                        mDragging = false;
+    int                         mDragGesture = 0;
+    QHash<QUuid, NodeID>        mDraggedNodes;  // moved since the last mouse move
+    QMultiHash<QUuid, ConnectionItem *> mConnectionItems;  // by both port IDs
+    int                         mBatch = 0;
     bool                        mDebug = false;
+    bool                        mShowDamage = false;
+    QVector<QRectF>             mDamage;        // invalidated since the last paint
+    QVector<QRectF>             mShownDamage;   // outlined by the last paint
     bool                        mDrawGrid = true;
+    qreal                       mLowDetailThreshold = 0.4;
+    qreal                       mMediumDetailThreshold = 0.7;
 
     bool                        mCreateConnection = false;
     QPointF                     mCreatePoint;
@@ -114,6 +230,12 @@ private:
     PortID                      mCreatePort;
     QScopedPointer<ConnectionShape> mCreateShape;
     QPointF                     mCreateOffset;
+    QRectF                      mCreateDamage;
+    QPointF                     mCreateTarget;
+    bool                        mCreatePlanned = false;
+    int                         mPreviewInterval = 16;
+    QElapsedTimer               mCreatePlanTime;
+    QTimer                      mCreatePlanTimer;
 };
 
 // ----------------------------------------------------------------------------
@@ -1,7 +1,13 @@
 
 // ----------------------------------------------------------------------------
 
+#include <climits>
+
+// ----------------------------------------------------------------------------
+
+#include <QApplication>
 #include <QCheckBox>
+#include <QClipboard>
 #include <QContextMenuEvent>
 #include <QDebug>
 #include <QDialogButtonBox>
@@ -9,6 +15,7 @@
 #include <QButtonGroup>
 #include <QInputDialog>
 #include <QMenu>
+#include <QMimeData>
 #include <QUndoStack>
 
 // ----------------------------------------------------------------------------
@@ -29,6 +36,11 @@ namespace nod { namespace qgs {
 
 // ----------------------------------------------------------------------------
 
+/// Estimated bytes still held by a released command, bounds the stack count.
+static const qint64 ReleasedCommandSize = 64;
+
+// ----------------------------------------------------------------------------
+
 NodeView::NodeView(QUndoStack *undo_stack, NodeScene *scene, QWidget *parent)
     : QGraphicsView(scene, parent),
       mUndo(undo_stack),
@@ -40,6 +52,9 @@ NodeView::NodeView(QUndoStack *undo_stack, NodeScene *scene, QWidget *parent)
     connect(mScene, &NodeScene::selectionChanged,
             this, &NodeView::selectionChanged);
 
+    connect(mScene, &NodeScene::nodesMoved,
+            this, &NodeView::nodesMoved);
+
     // TODO: add more keyboard shortcuts
 
     QAction *debug = new QAction(tr("&Debug"), this);
@@ -117,21 +132,21 @@ NodeView::NodeView(QUndoStack *undo_stack, NodeScene *scene, QWidget *parent)
 
     auto paste = new QAction(tr("&Paste"), this);
     paste->setShortcut(Qt::CTRL + Qt::Key_V);
-    connect(copy, &QAction::triggered, this, &NodeView::paste);
+    connect(paste, &QAction::triggered, this, &NodeView::paste);
     mActions[int(Action::Paste)] = paste;
 
     /* undo, redo */
 
     auto undo = undo_stack->createUndoAction(this);
     undo->setShortcut(Qt::CTRL + Qt::Key_Z);
-    connect(undo, &QAction::triggered, this, &NodeView::paste);
     mActions[int(Action::Undo)] = undo;
 
     auto redo = undo_stack->createRedoAction(this);
     redo->setShortcut(Qt::CTRL + Qt::SHIFT + Qt::Key_Z);
-    connect(redo, &QAction::triggered, this, &NodeView::redo);
     mActions[int(Action::Redo)] = redo;
 
+    connect(undo_stack, &QUndoStack::indexChanged, this, &NodeView::limitUndoMemory);
+
 }
 
 // ----------------------------------------------------------------------------
@@ -461,7 +476,7 @@ void NodeView::createNode()
 void NodeView::deleteSelection()
 {
     if (scene())
-        mUndo->push(new DeleteSelectionCommand(*scene()));
+        mUndo->push(new DeleteSelectionCommand(*scene(), mCompressUndoData));
 }
 
 // ----------------------------------------------------------------------------
@@ -469,21 +484,171 @@ void NodeView::deleteSelection()
 void NodeView::cut()
 {
     if (scene())
-        mUndo->push(new CutSelectionCommand(*scene()));
+        mUndo->push(new CutSelectionCommand(*scene(), mCompressUndoData));
 }
 
 // ----------------------------------------------------------------------------
 
 void NodeView::copy()
 {
+    if (!scene())
+        return;
 
+    QVector<NodeID> nodes;
+    for (auto item : scene()->selectedItems())
+    {
+        auto node_item = qgraphicsitem_cast<NodeItem*>(item);
+        if (node_item)
+            nodes.append(node_item->node());
+    }
+
+    Serialized data(false);
+    if (!scene()->model()->writeNodes(data, nodes))
+        return;
+
+    auto mime = new QMimeData;
+    mime->setData(Serialized::mimeType(), data.payload());
+    QApplication::clipboard()->setMimeData(mime);
 }
 
 // ----------------------------------------------------------------------------
 
 void NodeView::paste()
 {
+    auto mime = QApplication::clipboard()->mimeData();
+    if (!scene() || !mime || !mime->hasFormat(Serialized::mimeType()))
+        return;
+
+    QScopedPointer<PasteCommand> cmd(new PasteCommand(*scene(), mime->data(Serialized::mimeType())));
+    if (mUndo)
+        mUndo->push(cmd.take());
+    else
+        cmd->redo();
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeView::setUndoMemoryLimit(qint64 bytes)
+{
+    // QUndoStack only takes a limit while empty, it then deletes the oldest
+    // commands on push and bounds the released ones
+    if (mUndo && mUndo->count() == 0)
+        mUndo->setUndoLimit(bytes > 0 ? int(qBound<qint64>(1, bytes / ReleasedCommandSize, INT_MAX)) : 0);
+
+    mUndoMemoryLimit = bytes;
+    mUndoSizes.clear();
+    mUndoBytes = 0;
+    limitUndoMemory();
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeView::measureUndo(const QUndoCommand *cmd)
+{
+    qint64 size = 0;
+    if (!cmd->isObsolete())
+    {
+        auto node_cmd = dynamic_cast<const NodeCommand *>(cmd);
+        size = node_cmd ? node_cmd->byteSize() : qint64(sizeof(QUndoCommand));
+    }
+
+    auto it = mUndoSizes.find(cmd);
+    if (it != mUndoSizes.end())
+    {
+        mUndoBytes += size - *it;
+        *it = size;
+    } else
+    {
+        mUndoBytes += size;
+        mUndoSizes.insert(cmd, size);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeView::limitUndoMemory()
+{
+    if (!mUndo)
+        return;
+
+    int count = mUndo->count();
+    int index = mUndo->index();
+
+    // released commands are the bottom of the stack, once undo reaches them
+    // undoing the rest deletes them (QUndoStack 5.9 and later), their undo()
+    // does nothing
+    if (index > 0 && mUndo->command(index - 1)->isObsolete())
+    {
+        mUndo->setIndex(0);
+        return;
+    }
+
+    if (mUndoMemoryLimit <= 0)
+        return;
+
+    // commands were pushed or deleted, e.g. a push dropping the redo branch,
+    // known commands keep their sizes
+    if (mUndoSizes.size() != count || (index > 0 && !mUndoSizes.contains(mUndo->command(index - 1))))
+    {
+        auto sizes = mUndoSizes;
+        mUndoSizes.clear();
+        mUndoBytes = 0;
 
+        for (int i=0; i<count; ++i)
+        {
+            auto cmd = mUndo->command(i);
+            auto it = sizes.constFind(cmd);
+            if (it != sizes.constEnd())
+            {
+                mUndoSizes.insert(cmd, *it);
+                mUndoBytes += *it;
+            } else
+                measureUndo(cmd);
+        }
+    }
+
+    // the commands around the index were pushed, merged, undone or redone
+    for (int i=qMax(index - 1, 0); i<=index && i<count; ++i)
+        measureUndo(mUndo->command(i));
+
+    // release from the oldest on, everything before a released command goes
+    // too, other commands can't promise a no-op undo and stop the release
+    for (int i=0; i<index && mUndoBytes > mUndoMemoryLimit; ++i)
+    {
+        auto cmd = const_cast<QUndoCommand *>(mUndo->command(i));
+        if (cmd->isObsolete())
+            continue;
+
+        auto node_cmd = dynamic_cast<NodeCommand *>(cmd);
+        if (!node_cmd)
+            break;
+
+        node_cmd->release();
+        measureUndo(cmd);
+    }
+
+    // nothing left to undo
+    if (index > 0 && mUndo->command(index - 1)->isObsolete())
+        mUndo->setIndex(0);
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeView::nodesMoved(const QVector<NodeID> &nodes, int gesture)
+{
+    QVector<QPointF> positions;
+    positions.reserve(nodes.size());
+    for (auto &node : nodes)
+    {
+        auto item = mScene->nodeItem(node);
+        positions.append(item ? item->pos() : QPointF());
+    }
+
+    QScopedPointer<MoveNodesCommand> cmd(new MoveNodesCommand(*mScene, nodes, positions, gesture));
+    if (mUndo)
+        mUndo->push(cmd.take());
+    else
+        cmd->redo();
 }
 
 // ----------------------------------------------------------------------------
@@ -7,6 +7,7 @@
 // ----------------------------------------------------------------------------
 
 #include <QGraphicsView>
+#include <QHash>
 #include <QMenu>
 
 // ----------------------------------------------------------------------------
@@ -75,6 +76,26 @@ public:
 
     QUndoStack                  *undoStack() const { return mUndo; }
 
+    /// Compress the selection stored by delete and cut commands, enabled by default.
+    void                        setCompressUndoData(bool compress) { mCompressUndoData = compress; }
+
+    bool                        compressUndoData() const { return mCompressUndoData; }
+
+    /** Sets a byte budget for the undo stack.
+     *
+     * Commands report their memory with NodeCommand::byteSize(), sizes are
+     * measured when commands are pushed, merged, undone or redone. When the
+     * budget is exceeded the oldest commands are released, they can no longer
+     * be undone. Released commands are deleted as soon as undo reaches them.
+     * Set on an empty stack the budget also becomes its undo limit, one
+     * command per 64 bytes, so the stack drops the oldest commands on push.
+     * 0 disables the budget.
+     *
+     */
+    void                        setUndoMemoryLimit(qint64 bytes);
+
+    qint64                      undoMemoryLimit() const { return mUndoMemoryLimit; }
+
     virtual QMenu               *createMenu();
 
     virtual AlignDialog         *createAlignDialog();
@@ -128,9 +149,23 @@ public slots:
 
     virtual void                undo();
 
+private slots:
+
+    void                        limitUndoMemory();
+
+    /// Measures a command again and updates the running total.
+    void                        measureUndo(const QUndoCommand *cmd);
+
+    /// Pushes a MoveNodesCommand, the moves of one drag merge.
+    void                        nodesMoved(const QVector<NodeID> &nodes, int gesture);
+
 private:
 
     QUndoStack                  *mUndo = nullptr;
+    bool                        mCompressUndoData = true;
+    qint64                      mUndoMemoryLimit = 0;
+    QHash<const QUndoCommand *, qint64> mUndoSizes;     // measured byte sizes
+    qint64                      mUndoBytes = 0;         // sum of mUndoSizes
 
     NodeScene                   *mScene;
 
@@ -2,6 +2,7 @@
 // ----------------------------------------------------------------------------
 
 #include <iomanip>
+#include <limits>
 #include <sstream>
 
 // ----------------------------------------------------------------------------
@@ -20,6 +21,10 @@ namespace nod { namespace qgs {
 
 // ----------------------------------------------------------------------------
 
+static const int Infinite = std::numeric_limits<int>::max() / 4;
+
+// ----------------------------------------------------------------------------
+
 inline bool operator<(const CellRef &a, const CellRef &b)
 {
     return b.priority < a.priority;
@@ -55,7 +60,7 @@ static int manhatten(const GridCell &a, const GridCell &b)
 
 // ----------------------------------------------------------------------------
 
-static void dumpCosts(const NodeGrid &grid, int searchno)
+Q_DECL_UNUSED static void dumpCosts(const NodeGrid &grid, int searchno)
 {
     std::stringstream s;
 
@@ -148,13 +153,14 @@ PathPlanner::Result PathPlanner::plan(QVector<QPointF> &path, const QPointF &p1,
     auto c1 = line.p1();
     auto c2 = line.p2();
 
-    qDebug() << "A* from cell" << c1 << "to" << c2;
+    //qDebug() << "A* from cell" << c1 << "to" << c2;
 
     auto cell = mGrid.cell(c1);
     if (!cell)
         return Result::NoPath;
 
     cell->from = -1;
+    cell->cost = 0;
     cell->visited = mSearchNo;
 
     mFrontier = std::priority_queue<CellRef>();
@@ -165,13 +171,16 @@ PathPlanner::Result PathPlanner::plan(QVector<QPointF> &path, const QPointF &p1,
 
     int iteration = 0;
     int last_index = -1;
+    int closest_index = -1;
+    int closest_distance = 0;
+    bool found = false;
     while (!mFrontier.empty())
     {
         if (iteration++ > 500)
             break;
 
 
-        qDebug() << "A* frontier pop " << mFrontier.top().cell_index << mFrontier.top().priority << "size:" << mFrontier.size();
+        //qDebug() << "A* frontier pop " << mFrontier.top().cell_index << mFrontier.top().priority << "size:" << mFrontier.size();
 
         auto from = mFrontier.top();
         auto cell = mGrid.cell(from.cell_index);
@@ -181,13 +190,21 @@ PathPlanner::Result PathPlanner::plan(QVector<QPointF> &path, const QPointF &p1,
 
         last_index = from.cell_index;
 
+        int distance = std::abs(cell->i - c2.x()) + std::abs(cell->j - c2.y());
+        if (closest_index < 0 || distance < closest_distance)
+        {
+            closest_index = last_index;
+            closest_distance = distance;
+        }
+
         if (cell->i == c2.x() && cell->j == c2.y())
         {
-            qDebug() << "A* found" << cell->i << cell->j;
+            //qDebug() << "A* found" << cell->i << cell->j;
+            found = true;
             break;
         }
 
-        dumpCosts(mGrid, mSearchNo);
+        //dumpCosts(mGrid, mSearchNo);
 
         int ni[4][2] =
         {
@@ -220,7 +237,7 @@ PathPlanner::Result PathPlanner::plan(QVector<QPointF> &path, const QPointF &p1,
 
             int cost = cell->cost;
 
-            qDebug() << "A* cost" << ncell->i << ncell->j << cost;
+            //qDebug() << "A* cost" << ncell->i << ncell->j << cost;
 
             int user_cost = fn(*ncell);
             if (user_cost < 0)
@@ -274,6 +291,10 @@ PathPlanner::Result PathPlanner::plan(QVector<QPointF> &path, const QPointF &p1,
     if (last_index < 0)
         return Result::NoPath;
 
+    // end at the closest cell reached if the goal wasn't
+    if (!found)
+        last_index = closest_index;
+
     while (last_index >= 0)
     {
         auto cell = mGrid.cell(last_index);
@@ -293,7 +314,7 @@ PathPlanner::Result PathPlanner::plan(QVector<QPointF> &path, const QPointF &p1,
 
     //qDebug() << "A* path" << path;
 
-    return Result::Found;
+    return found ? Result::Found : Result::Blocked;
 #if 0
     path.clear();
 
@@ -775,6 +796,246 @@ bool PathPlanner::isBlocked(const GridCell &cell) const
 
 // ----------------------------------------------------------------------------
 
+PathPlanner::Result PathPlanner::plan(State &state, QVector<QPointF> &path, const QPointF &p1, const QPointF &p2, std::function<int (const GridCell &)> fn)
+{
+    if (mMode == Mode::Full)
+    {
+        state = State();
+        return plan(path, p1, p2, fn);
+    }
+
+    path.clear();
+    mExpansions = 0;
+
+    auto line = mGrid.clipCellLine(QLine(mGrid.cellAt(p1), mGrid.cellAt(p2)));
+    if (line.isNull())
+        return Result::NoPath;
+
+    int start = mGrid.cellIndex(line.p1());
+    int goal = mGrid.cellIndex(line.p2());
+    if (start < 0 || goal < 0)
+        return Result::NoPath;
+
+    int count = mGrid.cells().width() * mGrid.cells().height();
+
+    const int *changed = nullptr;
+    int changed_count = 0;
+    bool reset = state.grid_version != mGrid.version() || state.start != start ||
+                 state.goal != goal || state.g.size() != count ||
+                 !mGrid.changesSince(state.change_no, changed, changed_count);
+
+    state.change_no = mGrid.changeCount();
+
+    if (reset)
+    {
+        // nothing to repair, start over
+        state.grid_version = mGrid.version();
+        state.start = start;
+        state.goal = goal;
+        state.closest = -1;
+        state.g.fill(Infinite, count);
+        state.rhs.fill(Infinite, count);
+
+        state.queue = std::priority_queue<CellKey>();
+        state.rhs[start] = 0;
+        state.queue.push(key(state, start));
+    } else
+    {
+        // costs are paid when entering a cell, only the changed cells'
+        // rhs values change, computePath() propagates from there
+        for (int c=0; c<changed_count; ++c)
+            updateCell(state, changed[c], fn);
+    }
+
+    computePath(state, fn);
+
+    // like the full search, end at the closest cell reached if blocked
+    auto result = Result::Found;
+    int last = goal;
+    if (state.g[goal] >= Infinite)
+    {
+        result = Result::Blocked;
+        last = state.closest;
+        if (last < 0 || state.g[last] >= Infinite)
+        {
+            last = -1;
+            for (int i=0; i<count; ++i)
+            {
+                if (state.g[i] < Infinite && (last < 0 || distance(i, goal) < distance(last, goal)))
+                    last = i;
+            }
+        }
+
+        if (last < 0)
+            return Result::NoPath;
+    }
+
+    // walk back along the cheapest neighbours, prefer straight lines
+    int index = last;
+    int step = 0;
+    int n[4];
+    while (index >= 0)
+    {
+        auto cell = mGrid.cell(index);
+        path.append(mGrid.positionAt(QPoint(cell->i, cell->j)));
+
+        if (index == start || path.size() > count)
+            break;
+
+        int next = -1;
+        for (int i=0, nc=neighbours(index, n); i<nc; ++i)
+        {
+            if (state.g[n[i]] >= Infinite)
+                continue;
+
+            if (next < 0 || state.g[n[i]] < state.g[next] ||
+                (state.g[n[i]] == state.g[next] && index - n[i] == step))
+                next = n[i];
+        }
+
+        if (next >= 0)
+            step = index - next;
+
+        index = next;
+    }
+
+    for (int i=0, j=int(path.size())-1; i<j; ++i, --j)
+        std::swap(path[i], path[j]);
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+
+int PathPlanner::cellCost(const GridCell &cell, const std::function<int (const GridCell &)> &fn) const
+{
+    if (isBlocked(cell))
+        return Infinite;
+
+    int user_cost = fn(cell);
+    if (user_cost < 0)
+        return Infinite;
+
+    return 1 + user_cost;
+}
+
+// ----------------------------------------------------------------------------
+
+int PathPlanner::neighbours(int index, int *result) const
+{
+    int w = mGrid.cells().width();
+    int h = mGrid.cells().height();
+    int i = index % w;
+    int j = index / w;
+
+    int n = 0;
+    if (i > 0)
+        result[n++] = index - 1;
+    if (i < w - 1)
+        result[n++] = index + 1;
+    if (j > 0)
+        result[n++] = index - w;
+    if (j < h - 1)
+        result[n++] = index + w;
+
+    return n;
+}
+
+// ----------------------------------------------------------------------------
+
+int PathPlanner::distance(int index1, int index2) const
+{
+    int w = mGrid.cells().width();
+    return std::abs(index1 % w - index2 % w) + std::abs(index1 / w - index2 / w);
+}
+
+// ----------------------------------------------------------------------------
+
+CellKey PathPlanner::key(const State &state, int index) const
+{
+    int k2 = qMin(state.g[index], state.rhs[index]);
+    return { k2 >= Infinite ? Infinite : k2 + distance(index, state.goal), k2, index };
+}
+
+// ----------------------------------------------------------------------------
+
+void PathPlanner::updateCell(State &state, int index, const std::function<int (const GridCell &)> &fn)
+{
+    if (index != state.start)
+    {
+        int rhs = Infinite;
+        int cost = cellCost(*mGrid.cell(index), fn);
+        if (cost < Infinite)
+        {
+            int n[4];
+            for (int i=0, nc=neighbours(index, n); i<nc; ++i)
+            {
+                if (state.g[n[i]] < Infinite)
+                    rhs = qMin(rhs, state.g[n[i]] + cost);
+            }
+        }
+
+        state.rhs[index] = rhs;
+    }
+
+    // stale queue entries are skipped in computePath()
+    if (state.g[index] != state.rhs[index])
+        state.queue.push(key(state, index));
+}
+
+// ----------------------------------------------------------------------------
+
+void PathPlanner::computePath(State &state, const std::function<int (const GridCell &)> &fn)
+{
+    int n[4];
+    while (!state.queue.empty())
+    {
+        auto top = state.queue.top();
+        auto goal = key(state, state.goal);
+        if (!(goal < top) && state.g[state.goal] == state.rhs[state.goal])
+            break;
+
+        state.queue.pop();
+
+        int index = top.cell_index;
+        auto current = key(state, index);
+        if (state.g[index] == state.rhs[index] ||
+            current.k1 != top.k1 || current.k2 != top.k2)
+            continue;
+
+        ++mExpansions;
+
+        int nc = neighbours(index, n);
+        if (state.g[index] > state.rhs[index])
+        {
+            state.g[index] = state.rhs[index];
+
+            if (state.closest < 0 || distance(index, state.goal) < distance(state.closest, state.goal))
+                state.closest = index;
+        } else
+        {
+            state.g[index] = Infinite;
+            updateCell(state, index, fn);
+        }
+
+        for (int i=0; i<nc; ++i)
+            updateCell(state, n[i], fn);
+    }
+
+    // drop stale entries once they pile up
+    if (int(state.queue.size()) > 4 * state.g.size())
+    {
+        state.queue = std::priority_queue<CellKey>();
+        for (int i=0; i<state.g.size(); ++i)
+        {
+            if (state.g[i] != state.rhs[i])
+                state.queue.push(key(state, i));
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 } } // namespaces
 
 // ----------------------------------------------------------------------------
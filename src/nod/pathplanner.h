@@ -38,6 +38,23 @@ struct CellRef
 
 // ----------------------------------------------------------------------------
 
+/// Queue entry of the incremental search, k1 / k2 form the LPA* key.
+struct CellKey
+{
+    int                         k1, k2;
+    int                         cell_index;
+};
+
+// ----------------------------------------------------------------------------
+
+inline bool operator<(const CellKey &a, const CellKey &b)
+{
+    // reversed, std::priority_queue pops the largest element
+    return b.k1 < a.k1 || (b.k1 == a.k1 && b.k2 < a.k2);
+}
+
+// ----------------------------------------------------------------------------
+
 /**
  * Costs:
  *  * negative cost if close to node (less ankward paths)
@@ -53,24 +70,80 @@ public:
     enum class Result
     {
         NoPath, // no points
-        Blocked, // last path point is blocker
+        Blocked, // p2 not reached, last point is the closest cell reached
         Found // last point is p2
     };
 
+    enum class Mode
+    {
+        Full, // A* search from scratch on every plan
+        Incremental // LPA* search, repairs the previous result of a State
+    };
+
+    /** Search state of one path, kept between incremental plans.
+     *
+     * The state is reset if the start or goal cell or the grid layout
+     * changed. Otherwise only the cells logged by NodeGrid::changesSince()
+     * are updated and the search is repaired from there, so the cost
+     * function must only depend on the cell usage. The state holds two
+     * ints per grid cell.
+     *
+     */
+    struct State
+    {
+        int                     grid_version = -1;
+        int                     change_no = 0;
+        int                     start = -1;
+        int                     goal = -1;
+        int                     closest = -1;   // reached cell closest to the goal
+        QVector<int>            g, rhs;
+        std::priority_queue<CellKey> queue;
+    };
+
     PathPlanner(NodeGrid &grid);
 
+    void                        setMode(Mode mode) { mMode = mode; }
+
+    Mode                        mode() const { return mMode; }
+
     Result                      plan(QVector<QPointF> &path, const QPointF &p1, const QPointF &p2, std::function<int (const GridCell &)> fn);
 
+    /** Plans a path reusing the search state of a previous plan.
+     *
+     * In Mode::Full the state is ignored and a full search is done.
+     *
+     * @param state The search state of the path, owned by the caller.
+     *
+     */
+    Result                      plan(State &state, QVector<QPointF> &path, const QPointF &p1, const QPointF &p2, std::function<int (const GridCell &)> fn);
+
+    /// Number of cells expanded by the last incremental plan, for profiling.
+    int                         expansions() const { return mExpansions; }
+
 private:
 
     NodeGrid                    &mGrid;
     int                         mSearchNo = 0;
+    Mode                        mMode = Mode::Full;
+    int                         mExpansions = 0;
 
     std::priority_queue<CellRef> mFrontier;
     //std::deque<CellRef> mFrontier;
     //std::deque<int>             mFrontier;
 
     bool                        isBlocked(const GridCell &cell) const;
+
+    int                         cellCost(const GridCell &cell, const std::function<int (const GridCell &)> &fn) const;
+
+    int                         neighbours(int index, int *result) const;
+
+    int                         distance(int index1, int index2) const;
+
+    CellKey                     key(const State &state, int index) const;
+
+    void                        updateCell(State &state, int index, const std::function<int (const GridCell &)> &fn);
+
+    void                        computePath(State &state, const std::function<int (const GridCell &)> &fn);
 };
 
 // ----------------------------------------------------------------------------
@@ -0,0 +1,139 @@
+
+// ----------------------------------------------------------------------------
+
+#include <cmath>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/nodeitem.h"
+#include "nod/portindex.h"
+
+// ----------------------------------------------------------------------------
+
+namespace nod { namespace qgs {
+
+// ----------------------------------------------------------------------------
+
+PortIndex::PortIndex(int cell_size)
+    : mCellSize(cell_size)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+void PortIndex::clear()
+{
+    mCells.clear();
+    mItemCells.clear();
+    mDirty.clear();
+}
+
+// ----------------------------------------------------------------------------
+
+void PortIndex::invalidate(NodeItem *item)
+{
+    mDirty.insert(item);
+}
+
+// ----------------------------------------------------------------------------
+
+void PortIndex::remove(NodeItem *item)
+{
+    mDirty.remove(item);
+    erase(item);
+}
+
+// ----------------------------------------------------------------------------
+
+PortID PortIndex::portAt(const QPointF &pt, const NodeItem *item)
+{
+    if (!mDirty.isEmpty())
+    {
+        for (auto dirty : mDirty)
+            update(dirty);
+
+        mDirty.clear();
+    }
+
+    int i = int(std::floor(pt.x() / mCellSize));
+    int j = int(std::floor(pt.y() / mCellSize));
+
+    auto it = mCells.constFind(cellKey(i, j));
+    if (it == mCells.constEnd())
+        return PortID::invalid();
+
+    for (auto &entry : *it)
+    {
+        if ((!item || entry.item == item) && entry.rect.contains(pt))
+            return entry.port;
+    }
+
+    return PortID::invalid();
+}
+
+// ----------------------------------------------------------------------------
+
+quint64 PortIndex::cellKey(int i, int j) const
+{
+    return (quint64(quint32(i)) << 32) | quint32(j);
+}
+
+// ----------------------------------------------------------------------------
+
+void PortIndex::update(NodeItem *item)
+{
+    erase(item);
+
+    auto bounds = item->boundingRect();
+    auto &cells = mItemCells[item];
+
+    for (auto &port : item->portTable().ports)
+    {
+        auto rc = item->mapRectToScene(item->portRect(bounds, port.id));
+
+        int i0 = int(std::floor(rc.left() / mCellSize));
+        int j0 = int(std::floor(rc.top() / mCellSize));
+        int i1 = int(std::floor(rc.right() / mCellSize));
+        int j1 = int(std::floor(rc.bottom() / mCellSize));
+
+        for (int j=j0; j<=j1; ++j)
+        {
+            for (int i=i0; i<=i1; ++i)
+            {
+                auto key = cellKey(i, j);
+                mCells[key].append({ item, port.id, rc });
+                if (!cells.contains(key))
+                    cells.append(key);
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void PortIndex::erase(NodeItem *item)
+{
+    auto cells = mItemCells.take(item);
+    for (auto key : cells)
+    {
+        auto it = mCells.find(key);
+        if (it == mCells.end())
+            continue;
+
+        auto &entries = *it;
+        for (int i=entries.size()-1; i>=0; --i)
+        {
+            if (entries[i].item == item)
+                entries.remove(i);
+        }
+
+        if (entries.isEmpty())
+            mCells.erase(it);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+} } // namespaces
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,86 @@
+
+// ----------------------------------------------------------------------------
+
+#ifndef NOD_PORTINDEX_H
+#define NOD_PORTINDEX_H
+
+// ----------------------------------------------------------------------------
+
+#include <QHash>
+#include <QRectF>
+#include <QSet>
+#include <QVector>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/common.h"
+
+// ----------------------------------------------------------------------------
+
+namespace nod { namespace qgs {
+
+// ----------------------------------------------------------------------------
+
+/** Uniform grid over the port rects of all nodes in scene coordinates.
+ *
+ * Used for hit testing ports on mouse press and release. Nodes are marked
+ * dirty when they move or their geometry changes and are reindexed on the
+ * next lookup, so a drag only pays for one update.
+ *
+ */
+class PortIndex
+{
+public:
+
+    enum
+    {
+        DefaultCellSize         = 96
+    };
+
+    PortIndex(int cell_size=DefaultCellSize);
+
+    void                        clear();
+
+    /// Marks the ports of a node as changed.
+    void                        invalidate(NodeItem *item);
+
+    void                        remove(NodeItem *item);
+
+    /** Returns the port of a node at a scene position.
+     *
+     * @param pt The position in scene coordinates.
+     * @param item The node to look up ports for, nullptr for any node.
+     *
+     */
+    PortID                      portAt(const QPointF &pt, const NodeItem *item=nullptr);
+
+private:
+
+    struct Entry
+    {
+        NodeItem                *item;
+        PortID                  port;
+        QRectF                  rect;       // scene coordinates
+    };
+
+    int                         mCellSize;
+    QHash<quint64, QVector<Entry>> mCells;
+    QHash<NodeItem *, QVector<quint64>> mItemCells;   // cells an item's ports are in
+    QSet<NodeItem *>            mDirty;
+
+    quint64                     cellKey(int i, int j) const;
+
+    void                        update(NodeItem *item);
+
+    void                        erase(NodeItem *item);
+};
+
+// ----------------------------------------------------------------------------
+
+} } // namespaces
+
+// ----------------------------------------------------------------------------
+
+#endif // NOD_PORTINDEX_H
+
+// ----------------------------------------------------------------------------
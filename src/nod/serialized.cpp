@@ -1,6 +1,10 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QRectF>
+
+// ----------------------------------------------------------------------------
+
 #include "nod/serialized.h"
 
 // ----------------------------------------------------------------------------
@@ -16,6 +20,41 @@ Serialized::Serialized(bool reading)
 
 // ----------------------------------------------------------------------------
 
+void Serialized::compress(int level)
+{
+    if (isCompressed())
+        return;
+
+    mPayload = qCompress(mDoc.toJson(QJsonDocument::Compact), level);
+    mDoc = QJsonDocument();
+}
+
+// ----------------------------------------------------------------------------
+
+QByteArray Serialized::payload()
+{
+    compress();
+    return mPayload;
+}
+
+// ----------------------------------------------------------------------------
+
+void Serialized::setPayload(const QByteArray &payload)
+{
+    mDoc = QJsonDocument();
+    mPayload = payload;
+}
+
+// ----------------------------------------------------------------------------
+
+void Serialized::unpack()
+{
+    mDoc = QJsonDocument::fromJson(qUncompress(mPayload));
+    mPayload.clear();
+}
+
+// ----------------------------------------------------------------------------
+
 QJsonValue Serialized::toJson(const QVariant &var)
 {
     switch (var.type())
@@ -60,6 +99,39 @@ QJsonValue Serialized::toJson(const QVariant &var)
 
 // ----------------------------------------------------------------------------
 
+QRectF Serialized::toRectF(const QJsonValue &var)
+{
+    auto arr = var.toArray();
+    if (arr.size() != 4)
+        return QRectF();
+
+    return QRectF(arr[0].toDouble(), arr[1].toDouble(), arr[2].toDouble(), arr[3].toDouble());
+}
+
+// ----------------------------------------------------------------------------
+
+QSizeF Serialized::toSizeF(const QJsonValue &var)
+{
+    auto arr = var.toArray();
+    if (arr.size() != 2)
+        return QSizeF();
+
+    return QSizeF(arr[0].toDouble(), arr[1].toDouble());
+}
+
+// ----------------------------------------------------------------------------
+
+QPointF Serialized::toPointF(const QJsonValue &var)
+{
+    auto arr = var.toArray();
+    if (arr.size() != 2)
+        return QPointF();
+
+    return QPointF(arr[0].toDouble(), arr[1].toDouble());
+}
+
+// ----------------------------------------------------------------------------
+
 } // namespace nod
 
 // ----------------------------------------------------------------------------
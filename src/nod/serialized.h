@@ -9,6 +9,7 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QVector>
 
 // ----------------------------------------------------------------------------
 
@@ -24,13 +25,18 @@ namespace nod {
 
 // ----------------------------------------------------------------------------
 
+class NodeFactory;
+
+// ----------------------------------------------------------------------------
+
 class Serialized
 {
 public:
 
     Serialized(bool reading);
 
-    QJsonDocument               &doc() { return mDoc; }
+    /// The document, a compressed payload is decompressed on first access.
+    QJsonDocument               &doc() { if (!mPayload.isEmpty()) unpack(); return mDoc; }
 
     bool                        isReading() const { return mReading; }
 
@@ -44,6 +50,68 @@ public:
 
     int                         maxSerializedRole() const { return mMaxSerializedRole; }
 
+    /** Sets a device to stream to.
+     *
+     * When writing with a device set, models write their data to the device
+     * while iterating instead of building doc().
+     *
+     */
+    void                        setDevice(QIODevice *device) { mDevice = device; }
+
+    QIODevice                   *device() const { return mDevice; }
+
+    /// Sets the factory used to create nodes when reading.
+    void                        setNodeFactory(NodeFactory *factory) { mNodeFactory = factory; }
+
+    NodeFactory                 *nodeFactory() const { return mNodeFactory; }
+
+    /** Writes IDs as indexes into a single UUID table.
+     *
+     * Each node and port UUID is then written once, reading accepts both
+     * forms.
+     *
+     */
+    void                        setCompactIDs(bool compact=true) { mCompactIDs = compact; }
+
+    bool                        compactIDs() const { return mCompactIDs; }
+
+    /// Creates read nodes with new IDs instead of the stored ones, e.g. for pasting.
+    void                        setNewIDs(bool new_ids=true) { mNewIDs = new_ids; }
+
+    bool                        newIDs() const { return mNewIDs; }
+
+    /// Called by models for each node created while reading.
+    void                        addReadNode(const NodeID &node) { mReadNodes.append(node); }
+
+    /// IDs of the nodes created while reading, in stored order.
+    const QVector<NodeID>       &readNodes() const { return mReadNodes; }
+
+    /* Payload */
+
+    /** Replaces doc() by a compressed copy.
+     *
+     * Use this to keep serialized data around cheaply, e.g. in undo
+     * commands. The next doc() call decompresses it again.
+     *
+     * @param level The zlib compression level, -1 for the default.
+     *
+     */
+    void                        compress(int level=-1);
+
+    bool                        isCompressed() const { return !mPayload.isEmpty(); }
+
+    /// Returns the compressed document, compresses it first if needed.
+    QByteArray                  payload();
+
+    /// Sets a compressed document returned by payload().
+    void                        setPayload(const QByteArray &payload);
+
+    /// Size of the compressed document, 0 if not compressed.
+    int                         payloadSize() const { return mPayload.size(); }
+
+    /// MIME type for payloads on the clipboard.
+    static const char           *mimeType() { return "application/x-nod-graph"; }
+
     static QJsonValue           toJson(const QVariant &var);
 
     static QRectF               toRectF(const QJsonValue &var);
@@ -60,6 +128,19 @@ private:
 
     int                         mMaxSerializedRole = int(DataRole::MaxSerializedRole);
 
+    QIODevice                   *mDevice = nullptr;
+
+    NodeFactory                 *mNodeFactory = nullptr;
+
+    bool                        mCompactIDs = false;
+
+    bool                        mNewIDs = false;
+    QVector<NodeID>             mReadNodes;
+
+    QByteArray                  mPayload;
+
+    void                        unpack();
+
 };
 
 // ----------------------------------------------------------------------------
@@ -7,6 +7,7 @@
 
 #include "nod/nodemodel.h"
 #include "nod/nodeitem.h"
+#include "nod/nodeitemfactory.h"
 #include "nod/undo.h"
 
 // ----------------------------------------------------------------------------
@@ -15,8 +16,62 @@ namespace nod { namespace qgs {
 
 // ----------------------------------------------------------------------------
 
-DeleteSelectionCommand::DeleteSelectionCommand(NodeScene &scene)
-    : SerializedSelectionCommand(scene)
+qint64 NodeCommand::byteSize() const
+{
+    qint64 size = text().size() * qint64(sizeof(QChar));
+
+    for (int i=0; i<childCount(); ++i)
+    {
+        auto cmd = dynamic_cast<const NodeCommand *>(child(i));
+        size += cmd ? cmd->byteSize() : qint64(sizeof(QUndoCommand));
+    }
+
+    return size;
+}
+
+// ----------------------------------------------------------------------------
+
+void NodeCommand::release()
+{
+    for (int i=0; i<childCount(); ++i)
+    {
+        auto cmd = dynamic_cast<NodeCommand *>(const_cast<QUndoCommand *>(child(i)));
+        if (cmd)
+            cmd->release();
+    }
+
+    setObsolete(true);
+}
+
+// ----------------------------------------------------------------------------
+
+qint64 NodeCommand::byteSize(const QVariant &value)
+{
+    qint64 size = sizeof(QVariant);
+
+    switch (value.type())
+    {
+    case QVariant::String:
+        size += value.toString().size() * qint64(sizeof(QChar));
+        break;
+    case QVariant::ByteArray:
+        size += value.toByteArray().size();
+        break;
+    case QVariant::StringList:
+        for (auto &str : value.toStringList())
+            size += sizeof(QString) + str.size() * qint64(sizeof(QChar));
+        break;
+    default:
+        break;
+    }
+
+    return size;
+}
+
+// ----------------------------------------------------------------------------
+
+DeleteSelectionCommand::DeleteSelectionCommand(NodeScene &scene, bool compress)
+    : SerializedSelectionCommand(scene, compress)
 {
 
 }
@@ -37,7 +92,7 @@ void DeleteSelectionCommand::undo()
 
 // ----------------------------------------------------------------------------
 
-SerializedSelectionCommand::SerializedSelectionCommand(NodeScene &scene)
+SerializedSelectionCommand::SerializedSelectionCommand(NodeScene &scene, bool compress)
     : mData(false)
 {
     QVector<NodeID> nodes;
@@ -53,15 +108,36 @@ SerializedSelectionCommand::SerializedSelectionCommand(NodeScene &scene)
     if (!scene.model()->writeNodes(mData, nodes))
         qWarning() << "Model serialization failed";
 
-    qDebug() << "SerializedSelectionCommand: serialized selection" << qPrintable(mData.doc().toJson(QJsonDocument::Indented));
+    if (compress)
+    {
+        mData.compress();
+        mDataSize = mData.payloadSize();
+    } else
+        mDataSize = mData.doc().toJson(QJsonDocument::Compact).size();
 
     mData.setReading();
 }
 
 // ----------------------------------------------------------------------------
 
-CutSelectionCommand::CutSelectionCommand(NodeScene &scene)
-    : SerializedSelectionCommand(scene)
+qint64 SerializedSelectionCommand::byteSize() const
+{
+    return sizeof(*this) + NodeCommand::byteSize() + mDataSize;
+}
+
+// ----------------------------------------------------------------------------
+
+void SerializedSelectionCommand::release()
+{
+    mData.setPayload(QByteArray());
+    mDataSize = 0;
+    NodeCommand::release();
+}
+
+// ----------------------------------------------------------------------------
+
+CutSelectionCommand::CutSelectionCommand(NodeScene &scene, bool compress)
+    : SerializedSelectionCommand(scene, compress)
 {
 
 }
@@ -82,6 +158,300 @@ void CutSelectionCommand::undo()
 
 // ----------------------------------------------------------------------------
 
+PasteCommand::PasteCommand(NodeScene &scene, const QByteArray &payload)
+    : mScene(scene),
+      mPayload(payload)
+{
+    setText(QObject::tr("Paste"));
+}
+
+// ----------------------------------------------------------------------------
+
+void PasteCommand::redo()
+{
+    auto model = mScene.model();
+    if (!model || mPasted || mPayload.isEmpty())
+        return;
+
+    Serialized data(true);
+    data.setPayload(mPayload);
+    data.setNodeFactory(&mScene.itemFactory().nodeFactory());
+
+    // new IDs once, redo after undo restores the nodes written by undo()
+    data.setNewIDs(mNodes.isEmpty());
+
+    if (!model->serialize(data))
+        qWarning() << "PasteCommand: paste failed";
+
+    mNodes = data.readNodes();
+    mPasted = true;
+}
+
+// ----------------------------------------------------------------------------
+
+void PasteCommand::undo()
+{
+    auto model = mScene.model();
+    if (!model || !mPasted || mNodes.isEmpty())
+        return;
+
+    // connections to nodes that weren't pasted are lost, as when copying
+    Serialized data(false);
+    if (!model->writeNodes(data, mNodes))
+        return;
+
+    model->beginUpdate();
+
+    if (!model->deleteNode(mNodes.first()))
+    {
+        qWarning() << "PasteCommand: model can't delete nodes";
+        model->endUpdate();
+        return;
+    }
+
+    for (int i=1; i<mNodes.size(); ++i)
+        model->deleteNode(mNodes[i]);
+
+    model->endUpdate();
+
+    mPayload = data.payload();
+    mPasted = false;
+}
+
+// ----------------------------------------------------------------------------
+
+qint64 PasteCommand::byteSize() const
+{
+    return sizeof(*this) + NodeCommand::byteSize() + mPayload.size() + mNodes.size() * qint64(sizeof(NodeID));
+}
+
+// ----------------------------------------------------------------------------
+
+void PasteCommand::release()
+{
+    // nothing left to restore, pasted nodes stay
+    mPayload.clear();
+    mNodes.clear();
+    NodeCommand::release();
+}
+
+// ----------------------------------------------------------------------------
+
+UpdateNodeDataCommand::UpdateNodeDataCommand(NodeScene &scene, const NodeID &node, const QVariant &value, DataRole role,
+                                             int gesture, QUndoCommand *parent)
+    : NodeCommand(parent),
+      mModel(scene.model()),
+      mGesture(gesture),
+      mNodeID(node),
+      mRole(role),
+      mNew(value)
+{
+    if (mModel)
+        mOld = mModel->nodeData(node, role);
+}
+
+// ----------------------------------------------------------------------------
+
+void UpdateNodeDataCommand::redo()
+{
+    if (mModel)
+        mModel->setNodeData(mNodeID, mNew, mRole);
+}
+
+// ----------------------------------------------------------------------------
+
+void UpdateNodeDataCommand::undo()
+{
+    if (mModel)
+        mModel->setNodeData(mNodeID, mOld, mRole);
+}
+
+// ----------------------------------------------------------------------------
+
+bool UpdateNodeDataCommand::mergeWith(const QUndoCommand *other)
+{
+    auto cmd = static_cast<const UpdateNodeDataCommand *>(other);
+    if (!mGesture || cmd->mGesture != mGesture || cmd->mModel != mModel ||
+        cmd->mNodeID != mNodeID || cmd->mRole != mRole)
+        return false;
+
+    // keep the value from before the gesture
+    mNew = cmd->mNew;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+qint64 UpdateNodeDataCommand::byteSize() const
+{
+    return sizeof(*this) + NodeCommand::byteSize() + NodeCommand::byteSize(mOld) + NodeCommand::byteSize(mNew);
+}
+
+// ----------------------------------------------------------------------------
+
+void UpdateNodeDataCommand::release()
+{
+    mModel = nullptr;
+    mOld = QVariant();
+    mNew = QVariant();
+    NodeCommand::release();
+}
+
+// ----------------------------------------------------------------------------
+
+UpdatePortDataCommand::UpdatePortDataCommand(NodeScene &scene, const NodeID &node, const PortID &port, const QVariant &value, DataRole role,
+                                             int gesture, QUndoCommand *parent)
+    : NodeCommand(parent),
+      mModel(scene.model()),
+      mGesture(gesture),
+      mNodeID(node),
+      mPortID(port),
+      mRole(role),
+      mNew(value)
+{
+    if (mModel)
+        mOld = mModel->portData(node, port, role);
+}
+
+// ----------------------------------------------------------------------------
+
+void UpdatePortDataCommand::redo()
+{
+    if (mModel)
+        mModel->setPortData(mNodeID, mPortID, mNew, mRole);
+}
+
+// ----------------------------------------------------------------------------
+
+void UpdatePortDataCommand::undo()
+{
+    if (mModel)
+        mModel->setPortData(mNodeID, mPortID, mOld, mRole);
+}
+
+// ----------------------------------------------------------------------------
+
+bool UpdatePortDataCommand::mergeWith(const QUndoCommand *other)
+{
+    auto cmd = static_cast<const UpdatePortDataCommand *>(other);
+    if (!mGesture || cmd->mGesture != mGesture || cmd->mModel != mModel ||
+        cmd->mNodeID != mNodeID || cmd->mPortID != mPortID || cmd->mRole != mRole)
+        return false;
+
+    mNew = cmd->mNew;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+qint64 UpdatePortDataCommand::byteSize() const
+{
+    return sizeof(*this) + NodeCommand::byteSize() + NodeCommand::byteSize(mOld) + NodeCommand::byteSize(mNew);
+}
+
+// ----------------------------------------------------------------------------
+
+void UpdatePortDataCommand::release()
+{
+    mModel = nullptr;
+    mOld = QVariant();
+    mNew = QVariant();
+    NodeCommand::release();
+}
+
+// ----------------------------------------------------------------------------
+
+MoveNodesCommand::MoveNodesCommand(NodeScene &scene, const QVector<NodeID> &nodes, const QVector<QPointF> &positions, int gesture)
+    : mModel(scene.model()),
+      mGesture(gesture)
+{
+    setText(QObject::tr("Move"));
+
+    if (!mModel)
+        return;
+
+    for (int i=0; i<nodes.size() && i<positions.size(); ++i)
+    {
+        if (mIndex.contains(nodes[i].value))
+            continue;
+
+        mIndex.insert(nodes[i].value, mMoves.size());
+        mMoves.append({ nodes[i], mModel->nodePosition(nodes[i]), positions[i] });
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void MoveNodesCommand::redo()
+{
+    if (!mModel)
+        return;
+
+    mModel->beginUpdate();
+    for (auto &move : mMoves)
+        mModel->setNodeData(move.node, move.to, DataRole::Position);
+    mModel->endUpdate();
+}
+
+// ----------------------------------------------------------------------------
+
+void MoveNodesCommand::undo()
+{
+    if (!mModel)
+        return;
+
+    mModel->beginUpdate();
+    for (auto &move : mMoves)
+        mModel->setNodeData(move.node, move.from, DataRole::Position);
+    mModel->endUpdate();
+}
+
+// ----------------------------------------------------------------------------
+
+bool MoveNodesCommand::mergeWith(const QUndoCommand *other)
+{
+    auto cmd = static_cast<const MoveNodesCommand *>(other);
+    if (!mModel || !mGesture || cmd->mGesture != mGesture || cmd->mModel != mModel)
+        return false;
+
+    // known nodes keep the position from before the gesture
+    for (auto &move : cmd->mMoves)
+    {
+        auto it = mIndex.constFind(move.node.value);
+        if (it != mIndex.constEnd())
+        {
+            mMoves[*it].to = move.to;
+            continue;
+        }
+
+        mIndex.insert(move.node.value, mMoves.size());
+        mMoves.append(move);
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+qint64 MoveNodesCommand::byteSize() const
+{
+    return sizeof(*this) + NodeCommand::byteSize() +
+           mMoves.capacity() * qint64(sizeof(Move)) +
+           mIndex.size() * qint64(sizeof(QUuid) + sizeof(int) + 2 * sizeof(void *));
+}
+
+// ----------------------------------------------------------------------------
+
+void MoveNodesCommand::release()
+{
+    mModel = nullptr;
+    mMoves = QVector<Move>();
+    mIndex = QHash<QUuid, int>();
+    NodeCommand::release();
+}
+
+// ----------------------------------------------------------------------------
+
 } } // namespaces
 
 // ----------------------------------------------------------------------------
@@ -6,6 +6,7 @@
 
 // ----------------------------------------------------------------------------
 
+#include <QHash>
 #include <QUndoCommand>
 
 // ----------------------------------------------------------------------------
@@ -19,7 +20,43 @@ namespace nod { namespace qgs {
 
 // ----------------------------------------------------------------------------
 
-class CreateNodeCommand : public QUndoCommand
+/// Base of the node commands, reports its memory for the undo budget.
+class NodeCommand : public QUndoCommand
+{
+public:
+
+    /// IDs for QUndoCommand::id(), commands with the same ID may merge.
+    enum
+    {
+        UpdateNodeDataID        = 1,
+        UpdatePortDataID,
+        MoveNodesID
+    };
+
+    using QUndoCommand::QUndoCommand;
+
+    /** Approximate memory held by the command and its children.
+     *
+     * Subclasses add their own size and the data they hold.
+     *
+     */
+    virtual qint64      byteSize() const;
+
+    /** Drops the data held by the command and its children, marks it obsolete.
+     *
+     * Undo and redo of a released command do nothing. Subclasses clear
+     * their data and call the base.
+     *
+     */
+    virtual void        release();
+
+    /// Approximate memory held by a value.
+    static qint64       byteSize(const QVariant &value);
+};
+
+// ----------------------------------------------------------------------------
+
+class CreateNodeCommand : public NodeCommand
 {
 public:
 
@@ -38,17 +75,29 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class SerializedSelectionCommand : public QUndoCommand
+class SerializedSelectionCommand : public NodeCommand
 {
 public:
 
-    SerializedSelectionCommand(NodeScene &scene);
+    /// Serializes the selection, compressed if @a compress is set.
+    SerializedSelectionCommand(NodeScene &scene, bool compress=true);
 
-    Serialized          &selectionData() { return mData; }
+    /** A copy of the serialized selection for reading.
+     *
+     * Decoding the copy leaves the command's compressed data in place, so
+     * byteSize() stays accurate.
+     *
+     */
+    Serialized          selectionData() const { return mData; }
+
+    qint64              byteSize() const override;
+
+    void                release() override;
 
 private:
 
     Serialized          mData;
+    qint64              mDataSize = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -57,7 +106,7 @@ class DeleteSelectionCommand : public SerializedSelectionCommand
 {
 public:
 
-    DeleteSelectionCommand(NodeScene &scene);
+    DeleteSelectionCommand(NodeScene &scene, bool compress=true);
 
     void                redo() override;
 
@@ -73,7 +122,7 @@ class CutSelectionCommand : public SerializedSelectionCommand
 {
 public:
 
-    CutSelectionCommand(NodeScene &scene);
+    CutSelectionCommand(NodeScene &scene, bool compress=true);
 
     void                redo() override;
 
@@ -85,18 +134,69 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class UpdateNodeDataCommand : public QUndoCommand
+/** Pastes serialized nodes with new IDs.
+ *
+ * Undo writes the pasted nodes back to the payload and deletes them, redo
+ * then restores them with the same IDs. Undo requires NodeModel::deleteNode(),
+ * models without it keep the pasted nodes.
+ *
+ */
+class PasteCommand : public NodeCommand
 {
 public:
 
-    UpdateNodeDataCommand(NodeScene &scene, const NodeID &node, const QVariant &value, DataRole role);
+    /// @param payload A compressed document, see Serialized::payload().
+    PasteCommand(NodeScene &scene, const QByteArray &payload);
 
     void                redo() override;
 
     void                undo() override;
 
+    qint64              byteSize() const override;
+
+    void                release() override;
+
 private:
 
+    NodeScene           &mScene;
+    QByteArray          mPayload;
+    QVector<NodeID>     mNodes;     // pasted nodes, empty before the first redo
+    bool                mPasted = false;
+};
+
+// ----------------------------------------------------------------------------
+
+/** Sets a node data role, undo restores the previous value.
+ *
+ * Commands for the same node and role with the same non-zero @a gesture
+ * merge, e.g. the moves of one drag become a single undo step.
+ *
+ */
+class UpdateNodeDataCommand : public NodeCommand
+{
+public:
+
+    UpdateNodeDataCommand(NodeScene &scene, const NodeID &node, const QVariant &value, DataRole role,
+                          int gesture=0, QUndoCommand *parent=nullptr);
+
+    const NodeID        &node() const { return mNodeID; }
+
+    void                redo() override;
+
+    void                undo() override;
+
+    int                 id() const override { return UpdateNodeDataID; }
+
+    bool                mergeWith(const QUndoCommand *other) override;
+
+    qint64              byteSize() const override;
+
+    void                release() override;
+
+private:
+
+    NodeModel           *mModel;    // null once released
+    int                 mGesture;
     NodeID              mNodeID;
     DataRole            mRole;
     QVariant            mOld;
@@ -105,18 +205,30 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class UpdatePortDataCommand : public QUndoCommand
+/// Sets a port data role, merges like UpdateNodeDataCommand.
+class UpdatePortDataCommand : public NodeCommand
 {
 public:
 
-    UpdatePortDataCommand(NodeScene &scene, const NodeID &node, const PortID &port, const QVariant &value, DataRole role);
+    UpdatePortDataCommand(NodeScene &scene, const NodeID &node, const PortID &port, const QVariant &value, DataRole role,
+                          int gesture=0, QUndoCommand *parent=nullptr);
 
     void                redo() override;
 
     void                undo() override;
 
+    int                 id() const override { return UpdatePortDataID; }
+
+    bool                mergeWith(const QUndoCommand *other) override;
+
+    qint64              byteSize() const override;
+
+    void                release() override;
+
 private:
 
+    NodeModel           *mModel;    // null once released
+    int                 mGesture;
     NodeID              mNodeID;
     PortID              mPortID;
     DataRole            mRole;
@@ -126,7 +238,50 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class CreateConnectionCommand : public QUndoCommand
+/** Moves nodes, undo restores their previous positions.
+ *
+ * Moves with the same non-zero @a gesture merge into the first one, nodes
+ * joining the drag later are added to it.
+ *
+ */
+class MoveNodesCommand : public NodeCommand
+{
+public:
+
+    MoveNodesCommand(NodeScene &scene, const QVector<NodeID> &nodes, const QVector<QPointF> &positions, int gesture);
+
+    int                 nodeCount() const { return mMoves.size(); }
+
+    void                redo() override;
+
+    void                undo() override;
+
+    int                 id() const override { return MoveNodesID; }
+
+    bool                mergeWith(const QUndoCommand *other) override;
+
+    qint64              byteSize() const override;
+
+    void                release() override;
+
+private:
+
+    struct Move
+    {
+        NodeID          node;
+        QPointF         from;
+        QPointF         to;
+    };
+
+    NodeModel           *mModel;    // null once released
+    int                 mGesture;
+    QVector<Move>       mMoves;     // in the order nodes joined the drag
+    QHash<QUuid, int>   mIndex;     // in mMoves
+};
+
+// ----------------------------------------------------------------------------
+
+class CreateConnectionCommand : public NodeCommand
 {
 public:
 
@@ -137,7 +292,7 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class DeleteConnectionCommand : public QUndoCommand
+class DeleteConnectionCommand : public NodeCommand
 {
 public:
 
@@ -148,7 +303,7 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class SelectionChangedCommand : public QUndoCommand
+class SelectionChangedCommand : public NodeCommand
 {
 public:
 
@@ -163,14 +318,14 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class AlignNodesCommand : public QUndoCommand
+class AlignNodesCommand : public NodeCommand
 {
 
 };
 
 // ----------------------------------------------------------------------------
 
-class LayoutNodesCommand : public QUndoCommand
+class LayoutNodesCommand : public NodeCommand
 {
 
 };
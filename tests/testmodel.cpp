@@ -0,0 +1,203 @@
+
+// ----------------------------------------------------------------------------
+
+#include "testmodel.h"
+
+// ----------------------------------------------------------------------------
+
+namespace nod { namespace test {
+
+// ----------------------------------------------------------------------------
+
+NodeID TestModel::addNode(const NodeTypeID &type, const QPointF &position, const NodeID &id)
+{
+    Node node;
+    node.id = { id.isValid() ? id.value : QUuid::createUuid(), { 0 } };
+    node.type = type;
+    node.position = position;
+
+    for (int i=0; i<2; ++i)
+    {
+        PortID port = { QUuid::createUuidV5(node.id.value, QString::number(i)), { 0 } };
+        node.ports.append({ port, i == 0 ? Direction::Input : Direction::Output, QString() });
+    }
+
+    mIndex.insert(node.id.value, mNodes.size());
+    mNodes.append(node);
+
+    notifyNodeCreated(node.id);
+
+    return node.id;
+}
+
+// ----------------------------------------------------------------------------
+
+PortID TestModel::port(const NodeID &node, Direction direction) const
+{
+    auto n = find(node);
+    return n ? n->ports[direction == Direction::Input ? 0 : 1].id : PortID::invalid();
+}
+
+// ----------------------------------------------------------------------------
+
+const TestModel::Node *TestModel::find(const NodeID &node) const
+{
+    auto it = mIndex.constFind(node.value);
+    return it != mIndex.constEnd() ? &mNodes[*it] : nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+const TestModel::Port *TestModel::find(const NodeID &node, const PortID &port) const
+{
+    auto n = find(node);
+    if (!n)
+        return nullptr;
+
+    for (auto &p : n->ports)
+    {
+        if (p.id == port)
+            return &p;
+    }
+
+    return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+QVariant TestModel::nodeData(const NodeID &node, DataRole role) const
+{
+    auto n = find(node);
+    if (!n)
+        return QVariant();
+
+    switch (role)
+    {
+    case DataRole::Type: return n->type.value;
+    case DataRole::Position: return n->position;
+    case DataRole::Name: return n->name.isEmpty() ? QVariant() : n->name;
+    default: return n->values.value(int(role));
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void TestModel::setNodeData(const NodeID &node, const QVariant &value, DataRole role)
+{
+    auto it = mIndex.constFind(node.value);
+    if (it == mIndex.constEnd())
+        return;
+
+    auto &n = mNodes[*it];
+    if (role == DataRole::Position)
+        n.position = value.toPointF();
+    else
+    if (role == DataRole::Name)
+        n.name = value.toString();
+    else
+    if (role != DataRole::Type)
+        n.values.insert(int(role), value);
+    else
+        return;
+
+    notifyNodeDataChanged(node, role);
+}
+
+// ----------------------------------------------------------------------------
+
+NodeIt TestModel::firstNode() const
+{
+    if (mNodes.isEmpty())
+        return endNode();
+
+    return NodeIt(self(), mNodes[0].id, 0);
+}
+
+// ----------------------------------------------------------------------------
+
+NodeIt TestModel::endNode() const
+{
+    return NodeIt(self(), NodeID::invalid(), uint64_t(mNodes.size()));
+}
+
+// ----------------------------------------------------------------------------
+
+void TestModel::nextNode(NodeIt &it) const
+{
+    int index = int(it.data()) + 1;
+    it.update(index < mNodes.size() ? mNodes[index].id : NodeID::invalid(), uint64_t(index));
+}
+
+// ----------------------------------------------------------------------------
+
+PortIt TestModel::firstPort(const NodeID &node) const
+{
+    int index = mIndex.value(node.value, -1);
+    if (index < 0 || mNodes[index].ports.isEmpty())
+        return endPort(node);
+
+    return PortIt(self(), node, uint64_t(index), mNodes[index].ports[0].id, 0);
+}
+
+// ----------------------------------------------------------------------------
+
+PortIt TestModel::endPort(const NodeID &node) const
+{
+    int index = mIndex.value(node.value, -1);
+    int count = index < 0 ? 0 : mNodes[index].ports.size();
+
+    return PortIt(self(), node, uint64_t(index), PortID::invalid(), uint64_t(count));
+}
+
+// ----------------------------------------------------------------------------
+
+void TestModel::nextPort(PortIt &it) const
+{
+    auto &ports = mNodes[int(it.nodeData())].ports;
+    int index = int(it.portData()) + 1;
+    it.update(index < ports.size() ? ports[index].id : PortID::invalid(), uint64_t(index));
+}
+
+// ----------------------------------------------------------------------------
+
+QVariant TestModel::portData(const NodeID &node, const PortID &port, DataRole role) const
+{
+    auto p = find(node, port);
+    if (!p || role != DataRole::Name || p->name.isEmpty())
+        return QVariant();
+
+    return p->name;
+}
+
+// ----------------------------------------------------------------------------
+
+void TestModel::setPortData(const NodeID &node, const PortID &port, const QVariant &value, DataRole role)
+{
+    auto p = const_cast<Port *>(find(node, port));
+    if (!p || role != DataRole::Name)
+        return;
+
+    p->name = value.toString();
+    notifyPortDataChanged(node, port, role);
+}
+
+// ----------------------------------------------------------------------------
+
+Direction TestModel::portDirection(const NodeID &node, const PortID &port) const
+{
+    auto p = find(node, port);
+    return p ? p->direction : Direction::Input;
+}
+
+// ----------------------------------------------------------------------------
+
+NodeID TestFactory::createNode(NodeModel &model, const NodeTypeID &type, const QPointF &position, const NodeID &id)
+{
+    return static_cast<TestModel &>(model).addNode(type, position, id);
+}
+
+// ----------------------------------------------------------------------------
+
+} } // namespaces
+
+// ----------------------------------------------------------------------------
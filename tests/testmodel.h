@@ -0,0 +1,107 @@
+
+// ----------------------------------------------------------------------------
+
+#ifndef NOD_TESTS_TESTMODEL_H
+#define NOD_TESTS_TESTMODEL_H
+
+// ----------------------------------------------------------------------------
+
+#include <QHash>
+#include <QVector>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/abstractnodemodel.h"
+#include "nod/nodefactory.h"
+
+// ----------------------------------------------------------------------------
+
+namespace nod { namespace test {
+
+// ----------------------------------------------------------------------------
+
+/// Nodes with one input and one output port, port IDs derive from the node ID.
+class TestModel : public AbstractNodeModel
+{
+public:
+
+    struct Port
+    {
+        PortID                  id;
+        Direction               direction;
+        QString                 name;
+    };
+
+    struct Node
+    {
+        NodeID                  id;
+        NodeTypeID              type;
+        QPointF                 position;
+        QString                 name;
+        QHash<int, QVariant>    values;     // any other role
+        QVector<Port>           ports;
+    };
+
+    NodeID                      addNode(const NodeTypeID &type, const QPointF &position, const NodeID &id);
+
+    PortID                      port(const NodeID &node, Direction direction) const;
+
+    int                         nodeCount() const { return mNodes.size(); }
+
+    /* NodeModel */
+
+    QVariant                    nodeData(const NodeID &node, DataRole role) const override;
+
+    void                        setNodeData(const NodeID &node, const QVariant &value, DataRole role) override;
+
+    NodeIt                      firstNode() const override;
+
+    NodeIt                      endNode() const override;
+
+    void                        nextNode(NodeIt &it) const override;
+
+    PortIt                      firstPort(const NodeID &node) const override;
+
+    PortIt                      endPort(const NodeID &node) const override;
+
+    void                        nextPort(PortIt &it) const override;
+
+    QVariant                    portData(const NodeID &node, const PortID &port, DataRole role) const override;
+
+    void                        setPortData(const NodeID &node, const PortID &port, const QVariant &value, DataRole role) override;
+
+    Direction                   portDirection(const NodeID &node, const PortID &port) const override;
+
+    NodeFlags                   flags(const NodeID &) const override { return NodeFlags(); }
+
+private:
+
+    QVector<Node>               mNodes;
+    QHash<QUuid, int>           mIndex;
+
+    TestModel                   &self() const { return const_cast<TestModel &>(*this); }
+
+    const Node                  *find(const NodeID &node) const;
+
+    const Port                  *find(const NodeID &node, const PortID &port) const;
+};
+
+// ----------------------------------------------------------------------------
+
+/// Creates TestModel nodes.
+class TestFactory : public NodeFactory
+{
+public:
+
+    NodeID                      createNode(NodeModel &model, const NodeTypeID &type, const QPointF &position, const NodeID &id) override;
+};
+
+// ----------------------------------------------------------------------------
+
+} } // namespaces
+
+// ----------------------------------------------------------------------------
+
+#endif // NOD_TESTS_TESTMODEL_H
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,235 @@
+
+// ----------------------------------------------------------------------------
+
+#include <cstring>
+#include <limits>
+
+// ----------------------------------------------------------------------------
+
+#include <QBuffer>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/mappednodemodel.h"
+
+// ----------------------------------------------------------------------------
+
+#include "testmodel.h"
+
+// ----------------------------------------------------------------------------
+
+using namespace nod;
+using namespace nod::test;
+
+// ----------------------------------------------------------------------------
+
+namespace {
+
+// ----------------------------------------------------------------------------
+
+/// Byte offsets of the header fields, see MappedNodeModel::write().
+enum HeaderField
+{
+    NodeCount                   = 16,
+    PortCount                   = 24,
+    StringCount                 = 32,
+    Nodes                       = 40,
+    Ports                       = 48,
+    StringOffsets               = 56,
+    StringData                  = 64,
+    StringDataSize              = 72,
+
+    FirstNodeName               = 80 + 64      // NodeRecord::name of node 0
+};
+
+// ----------------------------------------------------------------------------
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+
+class TestMappedNodeModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void init();
+
+    void open();
+
+    void corruptHeader_data();
+    void corruptHeader();
+
+    void corruptString();
+
+private:
+
+    TestFactory                 mFactory;
+    TestModel                   mModel;
+    NodeID                      mFirst;
+    QByteArray                  mBytes;
+    QTemporaryDir               mDir;
+
+    /// Writes @a bytes to a file in mDir and returns its path.
+    QString                     writeFile(const QByteArray &bytes);
+
+    static quint64              field(const QByteArray &bytes, int offset);
+
+    static void                 setField(QByteArray &bytes, int offset, quint64 value);
+};
+
+// ----------------------------------------------------------------------------
+
+void TestMappedNodeModel::init()
+{
+    if (!mFirst.isValid())
+    {
+        NodeTypeID type = { QUuid::createUuid(), { 0 } };
+
+        NodeID nodes[3];
+        for (int i=0; i<3; ++i)
+        {
+            nodes[i] = mFactory.createNode(mModel, type, QPointF(i * 120, 48), NodeID::invalid());
+            mModel.setNodeData(nodes[i], QString("node %1").arg(i), DataRole::Name);
+        }
+
+        for (int i=0; i<2; ++i)
+        {
+            mModel.connect(nodes[i], mModel.port(nodes[i], Direction::Output),
+                           nodes[i + 1], mModel.port(nodes[i + 1], Direction::Input));
+        }
+
+        mFirst = nodes[0];
+    }
+
+    mBytes.clear();
+    QBuffer buffer(&mBytes);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(MappedNodeModel::write(mModel, buffer));
+}
+
+// ----------------------------------------------------------------------------
+
+QString TestMappedNodeModel::writeFile(const QByteArray &bytes)
+{
+    static int file_no = 0;
+
+    auto path = mDir.filePath(QString("graph%1.nodm").arg(file_no++));
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size())
+        return QString();
+
+    return path;
+}
+
+// ----------------------------------------------------------------------------
+
+quint64 TestMappedNodeModel::field(const QByteArray &bytes, int offset)
+{
+    quint64 value = 0;
+    std::memcpy(&value, bytes.constData() + offset, sizeof(value));
+    return value;
+}
+
+// ----------------------------------------------------------------------------
+
+void TestMappedNodeModel::setField(QByteArray &bytes, int offset, quint64 value)
+{
+    std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+// ----------------------------------------------------------------------------
+
+void TestMappedNodeModel::open()
+{
+    auto path = writeFile(mBytes);
+    QVERIFY(!path.isEmpty());
+
+    MappedNodeModel model;
+    int resets = 0;
+    QObject::connect(&model, &NodeModel::modelReset, [&resets] { ++resets; });
+    QVERIFY(model.open(path));
+    QCOMPARE(resets, 1);
+
+    int count = 0;
+    for (auto node : model.nodes())
+    {
+        QCOMPARE(model.nodeData(node, DataRole::Name), mModel.nodeData(node, DataRole::Name));
+        ++count;
+    }
+
+    QCOMPARE(count, 3);
+
+    PortID other;
+    auto output = mModel.port(mFirst, Direction::Output);
+    QVERIFY(model.connectedNode(mFirst, output, &other).isValid());
+}
+
+// ----------------------------------------------------------------------------
+
+void TestMappedNodeModel::corruptHeader_data()
+{
+    QTest::addColumn<int>("offset");
+    QTest::addColumn<quint64>("value");
+    QTest::addColumn<bool>("relative");
+
+    const auto max_int = quint64(std::numeric_limits<int>::max());
+
+    QTest::newRow("string count wraps") << int(StringCount) << std::numeric_limits<quint64>::max() << false;
+    QTest::newRow("string count too large") << int(StringCount) << max_int + 1 << false;
+    QTest::newRow("node count too large") << int(NodeCount) << max_int + 1 << false;
+    QTest::newRow("nodes past the end") << int(NodeCount) << quint64(1000) << false;
+    QTest::newRow("ports past the end") << int(Ports) << (quint64(1) << 40) << false;
+    QTest::newRow("unaligned nodes") << int(Nodes) << quint64(4) << true;
+    QTest::newRow("unaligned ports") << int(Ports) << quint64(4) << true;
+    QTest::newRow("unaligned string offsets") << int(StringOffsets) << quint64(4) << true;
+    QTest::newRow("string data past the end") << int(StringDataSize) << quint64(1) << true;
+}
+
+// ----------------------------------------------------------------------------
+
+void TestMappedNodeModel::corruptHeader()
+{
+    QFETCH(int, offset);
+    QFETCH(quint64, value);
+    QFETCH(bool, relative);
+
+    auto bytes = mBytes;
+    setField(bytes, offset, relative ? field(bytes, offset) + value : value);
+
+    auto path = writeFile(bytes);
+    QVERIFY(!path.isEmpty());
+
+    MappedNodeModel model;
+    QVERIFY(!model.open(path));
+    QVERIFY(!model.isOpen());
+    QVERIFY(model.nodes().begin() == model.nodes().end());
+}
+
+// ----------------------------------------------------------------------------
+
+void TestMappedNodeModel::corruptString()
+{
+    // a string index past the table is checked on access, not on open
+    auto bytes = mBytes;
+    quint32 index = 0x7ffffffe;
+    std::memcpy(bytes.data() + FirstNodeName, &index, sizeof(index));
+
+    auto path = writeFile(bytes);
+    QVERIFY(!path.isEmpty());
+
+    MappedNodeModel model;
+    QVERIFY(model.open(path));
+    QVERIFY(model.nodeData(mFirst, DataRole::Name).isNull());
+}
+
+// ----------------------------------------------------------------------------
+
+QTEST_MAIN(TestMappedNodeModel)
+
+#include "tst_mappednodemodel.moc"
+
+// ----------------------------------------------------------------------------
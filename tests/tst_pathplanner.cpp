@@ -0,0 +1,249 @@
+
+// ----------------------------------------------------------------------------
+
+#include <QtTest>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/defaultnodeitemfactory.h"
+#include "nod/nodefactory.h"
+#include "nod/nodegrid.h"
+#include "nod/nodescene.h"
+
+// ----------------------------------------------------------------------------
+
+using namespace nod;
+using namespace nod::qgs;
+
+// ----------------------------------------------------------------------------
+
+namespace {
+
+// ----------------------------------------------------------------------------
+
+class NullNodeFactory : public NodeFactory
+{
+public:
+
+    NodeID                      createNode(NodeModel &, const NodeTypeID &, const QPointF &, const NodeID &) override
+    {
+        return NodeID::invalid();
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+int zeroCost(const GridCell &)
+{
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+
+class TestPathPlanner : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    TestPathPlanner();
+
+private slots:
+
+    void init();
+
+    void found_data();
+    void found();
+
+    void blocked_data();
+    void blocked();
+
+    void repair();
+
+    void replan_data();
+    void replan();
+
+private:
+
+    NullNodeFactory             mNodeFactory;
+    DefaultNodeItemFactory      mItemFactory;
+    NodeScene                   mScene;
+
+    /// Resizes the grid to @a cells x @a cells empty cells.
+    void                        resetGrid(int cells);
+
+    /// Fills column @a i from row @a j1 to @a j2 (inclusive) with node cells.
+    void                        setWall(int i, int j1, int j2, CellUsage usage=CellUsage::Node);
+
+    QPointF                     at(int i, int j) const { return mScene.grid().positionAt(QPoint(i, j)); }
+};
+
+// ----------------------------------------------------------------------------
+
+TestPathPlanner::TestPathPlanner()
+    : mItemFactory(mNodeFactory),
+      mScene(mItemFactory)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::init()
+{
+    resetGrid(20);
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::resetGrid(int cells)
+{
+    const int size = cells * mScene.grid().gridSize();
+    mScene.setSceneRect(QRectF(0, 0, size, size));
+    mScene.grid().setSceneRect(mScene.sceneRect());
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::setWall(int i, int j1, int j2, CellUsage usage)
+{
+    mScene.grid().setCellUsage(QRect(i, j1, 1, j2 - j1 + 1), usage);
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::found_data()
+{
+    QTest::addColumn<bool>("incremental");
+
+    QTest::newRow("full") << false;
+    QTest::newRow("incremental") << true;
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::found()
+{
+    QFETCH(bool, incremental);
+
+    mScene.setIncrementalPlanning(incremental);
+    setWall(10, 5, 15);
+
+    PathPlanner::State state;
+    QVector<QPointF> path;
+    auto result = mScene.grid().planner().plan(state, path, at(2, 10), at(17, 10), zeroCost);
+
+    QCOMPARE(result, PathPlanner::Result::Found);
+    QVERIFY(path.size() >= 2);
+    QCOMPARE(path.first(), at(2, 10));
+    QCOMPARE(path.last(), at(17, 10));
+
+    for (const auto &pt : path)
+        QVERIFY(mScene.grid().usage(pt) != CellUsage::Node);
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::blocked_data()
+{
+    found_data();
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::blocked()
+{
+    QFETCH(bool, incremental);
+
+    mScene.setIncrementalPlanning(incremental);
+    setWall(10, 0, 19);
+
+    PathPlanner::State state;
+    QVector<QPointF> path;
+    auto result = mScene.grid().planner().plan(state, path, at(2, 10), at(17, 10), zeroCost);
+
+    // both planners return the partial path to the closest cell reached
+    QCOMPARE(result, PathPlanner::Result::Blocked);
+    QVERIFY(!path.isEmpty());
+    QCOMPARE(path.first(), at(2, 10));
+    QCOMPARE(mScene.grid().cellAt(path.last()).x(), 9);
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::repair()
+{
+    mScene.setIncrementalPlanning(true);
+    setWall(10, 0, 19);
+
+    auto &planner = mScene.grid().planner();
+    PathPlanner::State state;
+    QVector<QPointF> path;
+
+    QCOMPARE(planner.plan(state, path, at(2, 10), at(17, 10), zeroCost), PathPlanner::Result::Blocked);
+    const int initial_expansions = planner.expansions();
+
+    // open a gap, only the changed cells and their surroundings are searched again
+    setWall(10, 9, 11, CellUsage::Empty);
+
+    QCOMPARE(planner.plan(state, path, at(2, 10), at(17, 10), zeroCost), PathPlanner::Result::Found);
+    QCOMPARE(path.last(), at(17, 10));
+    QVERIFY(planner.expansions() < initial_expansions);
+
+    // the repaired path matches a search from scratch
+    PathPlanner::State fresh;
+    QVector<QPointF> fresh_path;
+    QCOMPARE(planner.plan(fresh, fresh_path, at(2, 10), at(17, 10), zeroCost), PathPlanner::Result::Found);
+    QCOMPARE(path.size(), fresh_path.size());
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::replan_data()
+{
+    found_data();
+}
+
+// ----------------------------------------------------------------------------
+
+void TestPathPlanner::replan()
+{
+    QFETCH(bool, incremental);
+
+    // the full search gives up after 500 expansions, with at most 400 cells
+    // both modes complete and the rows measure the same work
+    mScene.setIncrementalPlanning(incremental);
+    setWall(10, 3, 16);
+
+    auto &planner = mScene.grid().planner();
+    PathPlanner::State state;
+    QVector<QPointF> path;
+    QCOMPARE(planner.plan(state, path, at(2, 10), at(17, 10), zeroCost), PathPlanner::Result::Found);
+
+    // an obstacle moving back and forth next to the path, as while dragging a node
+    int step = 0;
+    auto result = PathPlanner::Result::Found;
+    QBENCHMARK {
+        const int j = 4 + step % 10;
+        setWall(14, j, j + 2);
+        auto moved = planner.plan(state, path, at(2, 10), at(17, 10), zeroCost);
+        if (moved != PathPlanner::Result::Found)
+            result = moved;
+        setWall(14, j, j + 2, CellUsage::Empty);
+        ++step;
+    }
+
+    QCOMPARE(result, PathPlanner::Result::Found);
+    QCOMPARE(path.last(), at(17, 10));
+}
+
+// ----------------------------------------------------------------------------
+
+QTEST_MAIN(TestPathPlanner)
+
+#include "tst_pathplanner.moc"
+
+// ----------------------------------------------------------------------------
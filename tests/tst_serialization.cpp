@@ -0,0 +1,227 @@
+
+// ----------------------------------------------------------------------------
+
+#include <memory>
+
+// ----------------------------------------------------------------------------
+
+#include <QBuffer>
+#include <QtTest>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/binaryserializer.h"
+#include "nod/serialized.h"
+
+// ----------------------------------------------------------------------------
+
+#include "testmodel.h"
+
+// ----------------------------------------------------------------------------
+
+using namespace nod;
+using namespace nod::test;
+
+// ----------------------------------------------------------------------------
+
+class TestSerialization : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void init();
+
+    void json_data();
+    void json();
+
+    void binary();
+
+    void corruptBinary();
+
+    void duplicateConnections();
+
+private:
+
+    TestFactory                 mFactory;
+    std::unique_ptr<TestModel>  mModel;
+
+    static QJsonDocument        toJson(AbstractNodeModel &model);
+
+    static QByteArray           toBinary(NodeModel &model);
+};
+
+// ----------------------------------------------------------------------------
+
+void TestSerialization::init()
+{
+    mModel.reset(new TestModel());
+    auto &model = *mModel;
+
+    NodeTypeID type = { QUuid::createUuid(), { 0 } };
+
+    NodeID nodes[3];
+    for (int i=0; i<3; ++i)
+    {
+        nodes[i] = mFactory.createNode(model, type, QPointF(i * 120, 48), NodeID::invalid());
+        model.setNodeData(nodes[i], QString("node %1").arg(i), DataRole::Name);
+        model.setPortData(nodes[i], model.port(nodes[i], Direction::Output), QString("out"), DataRole::Name);
+    }
+
+    for (int i=0; i<2; ++i)
+    {
+        model.connect(nodes[i], model.port(nodes[i], Direction::Output),
+                      nodes[i + 1], model.port(nodes[i + 1], Direction::Input));
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+QJsonDocument TestSerialization::toJson(AbstractNodeModel &model)
+{
+    Serialized data(false);
+    if (!model.serialize(data))
+        return QJsonDocument();
+
+    return data.doc();
+}
+
+// ----------------------------------------------------------------------------
+
+QByteArray TestSerialization::toBinary(NodeModel &model)
+{
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+
+    BinarySerializer serializer(model);
+    if (!serializer.write(buffer))
+        return QByteArray();
+
+    return bytes;
+}
+
+// ----------------------------------------------------------------------------
+
+void TestSerialization::json_data()
+{
+    QTest::addColumn<bool>("compact");
+
+    QTest::newRow("uuids") << false;
+    QTest::newRow("compact") << true;
+}
+
+// ----------------------------------------------------------------------------
+
+void TestSerialization::json()
+{
+    QFETCH(bool, compact);
+
+    Serialized written(false);
+    written.setCompactIDs(compact);
+    QVERIFY(mModel->serialize(written));
+
+    TestModel model;
+    Serialized read(true);
+    read.doc() = written.doc();
+    read.setNodeFactory(&mFactory);
+    QVERIFY(model.serialize(read));
+
+    QCOMPARE(model.nodeCount(), 3);
+    QVERIFY(toJson(model) == toJson(*mModel));
+}
+
+// ----------------------------------------------------------------------------
+
+void TestSerialization::binary()
+{
+    // one role per value type the format distinguishes
+    const QVector<QPair<DataRole, QVariant>> typed =
+    {
+        { DataRole::Index, int(-3) },
+        { DataRole::Maximum, uint(7) },
+        { DataRole::Minimum, qlonglong(-5) },
+        { DataRole::PageStep, qulonglong(9) },
+        { DataRole::SingleStep, 0.5f },
+        { DataRole::Size, QSizeF(120, 72) },
+        { DataRole::Icon, QPoint(1, 2) },
+        { DataRole::Tooltip, QSize(3, 4) },
+        { DataRole::Color, QRect(1, 2, 3, 4) }
+    };
+
+    auto first = *mModel->nodes().begin();
+    for (auto &value : typed)
+        mModel->setNodeData(first, value.second, value.first);
+
+    auto bytes = toBinary(*mModel);
+    QVERIFY(!bytes.isEmpty());
+
+    TestModel model;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::ReadOnly);
+
+    BinarySerializer serializer(model);
+    QVERIFY(serializer.read(buffer, mFactory));
+    QCOMPARE(serializer.readNodes().size(), 3);
+
+    // the JSON writer sees the same model
+    QVERIFY(toJson(model) == toJson(*mModel));
+
+    // and role values come back with their original type
+    for (auto &value : typed)
+    {
+        auto read = model.nodeData(first, value.first);
+        QCOMPARE(read.userType(), value.second.userType());
+        QCOMPARE(read, value.second);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void TestSerialization::corruptBinary()
+{
+    auto bytes = toBinary(*mModel);
+    bytes.truncate(bytes.size() - 4);
+
+    TestModel model;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::ReadOnly);
+
+    BinarySerializer serializer(model);
+    QVERIFY(!serializer.read(buffer, mFactory));
+
+    // nothing is created from a stream that fails to decode
+    QCOMPARE(model.nodeCount(), 0);
+    QVERIFY(serializer.readNodes().isEmpty());
+}
+
+// ----------------------------------------------------------------------------
+
+void TestSerialization::duplicateConnections()
+{
+    QVector<Connection> connections;
+    for (auto node : mModel->nodes())
+    {
+        for (auto port : mModel->ports(node))
+        {
+            auto c = mModel->connection(node, port);
+            if (c.isValid())
+                connections.append(c);
+        }
+    }
+
+    // every connection is listed from both ends
+    QCOMPARE(connections.size(), 4);
+    QCOMPARE(mModel->connectAll(connections), 0);
+
+    auto json = toJson(*mModel);
+    QCOMPARE(json.object()["connections"].toArray().size(), 2);
+}
+
+// ----------------------------------------------------------------------------
+
+QTEST_MAIN(TestSerialization)
+
+#include "tst_serialization.moc"
+
+// ----------------------------------------------------------------------------
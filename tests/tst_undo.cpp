@@ -0,0 +1,200 @@
+
+// ----------------------------------------------------------------------------
+
+#include <memory>
+
+// ----------------------------------------------------------------------------
+
+#include <QUndoStack>
+#include <QtTest>
+
+// ----------------------------------------------------------------------------
+
+#include "nod/defaultnodeitemfactory.h"
+#include "nod/nodegrid.h"
+#include "nod/nodeitem.h"
+#include "nod/nodescene.h"
+#include "nod/nodeview.h"
+#include "nod/undo.h"
+
+// ----------------------------------------------------------------------------
+
+#include "testmodel.h"
+
+// ----------------------------------------------------------------------------
+
+using namespace nod;
+using namespace nod::qgs;
+using namespace nod::test;
+
+// ----------------------------------------------------------------------------
+
+class TestUndo : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    TestUndo();
+
+private slots:
+
+    void init();
+
+    void cleanup();
+
+    void mergeMoves();
+
+    void memoryLimit();
+
+private:
+
+    TestFactory                 mNodeFactory;
+    DefaultNodeItemFactory      mItemFactory;
+    TestModel                   mModel;
+    NodeID                      mNodes[2];
+    std::unique_ptr<NodeScene>  mScene;
+    std::unique_ptr<QUndoStack> mStack;
+    std::unique_ptr<NodeView>   mView;
+
+    /// Moves the items of @a nodes by @a delta and reports them as dragged.
+    void                        drag(const QVector<NodeID> &nodes, const QPointF &delta, int gesture);
+};
+
+// ----------------------------------------------------------------------------
+
+TestUndo::TestUndo()
+    : mItemFactory(mNodeFactory)
+{
+    NodeTypeID type = { QUuid::createUuid(), { 0 } };
+
+    for (int i=0; i<2; ++i)
+        mNodes[i] = mNodeFactory.createNode(mModel, type, QPointF(i * 120, 48), NodeID::invalid());
+}
+
+// ----------------------------------------------------------------------------
+
+void TestUndo::init()
+{
+    for (int i=0; i<2; ++i)
+        mModel.setNodeData(mNodes[i], QPointF(i * 120, 48), DataRole::Position);
+
+    mScene.reset(new NodeScene(mItemFactory));
+    mScene->setModel(&mModel);
+    mStack.reset(new QUndoStack());
+    mView.reset(new NodeView(mStack.get(), mScene.get()));
+}
+
+// ----------------------------------------------------------------------------
+
+void TestUndo::cleanup()
+{
+    mView.reset();
+    mStack.reset();
+    mScene.reset();
+}
+
+// ----------------------------------------------------------------------------
+
+void TestUndo::drag(const QVector<NodeID> &nodes, const QPointF &delta, int gesture)
+{
+    for (auto &node : nodes)
+    {
+        auto item = mScene->nodeItem(node);
+        QVERIFY(item);
+        item->setPos(item->pos() + delta);
+    }
+
+    emit mScene->nodesMoved(nodes, gesture);
+}
+
+// ----------------------------------------------------------------------------
+
+void TestUndo::mergeMoves()
+{
+    const QPointF a = mModel.nodePosition(mNodes[0]);
+    const QPointF b = mModel.nodePosition(mNodes[1]);
+    const qreal step = mScene->grid().gridSize();
+
+    // the second node joins the drag after the first mouse move
+    drag({ mNodes[0] }, QPointF(step, 0), 1);
+    drag({ mNodes[0], mNodes[1] }, QPointF(step, 0), 1);
+    drag({ mNodes[1], mNodes[0] }, QPointF(0, step), 1);
+
+    QCOMPARE(mStack->count(), 1);
+    auto cmd = static_cast<const MoveNodesCommand *>(mStack->command(0));
+    QCOMPARE(cmd->childCount(), 0);
+    QCOMPARE(cmd->nodeCount(), 2);
+
+    const QPointF a_moved = mScene->nodeItem(mNodes[0])->pos();
+    const QPointF b_moved = mScene->nodeItem(mNodes[1])->pos();
+    QVERIFY(a_moved != a && b_moved != b);
+    QCOMPARE(mModel.nodePosition(mNodes[0]), a_moved);
+    QCOMPARE(mModel.nodePosition(mNodes[1]), b_moved);
+
+    mStack->undo();
+    QCOMPARE(mModel.nodePosition(mNodes[0]), a);
+    QCOMPARE(mModel.nodePosition(mNodes[1]), b);
+
+    mStack->redo();
+    QCOMPARE(mModel.nodePosition(mNodes[0]), a_moved);
+    QCOMPARE(mModel.nodePosition(mNodes[1]), b_moved);
+
+    // the next drag is a separate step
+    drag({ mNodes[1] }, QPointF(step, 0), 2);
+    QCOMPARE(mStack->count(), 2);
+}
+
+// ----------------------------------------------------------------------------
+
+void TestUndo::memoryLimit()
+{
+    const QPointF start = mModel.nodePosition(mNodes[0]);
+    const qreal step = mScene->grid().gridSize();
+
+    qint64 size = MoveNodesCommand(*mScene, { mNodes[0] }, { start }, 0).byteSize();
+    mView->setUndoMemoryLimit(4 * size);
+    QVERIFY(mStack->undoLimit() > 4);
+
+    // positions[i] is where the i-th move left the node
+    const int moves = 3 * mStack->undoLimit();
+    QVector<QPointF> positions = { start };
+    for (int i=1; i<=moves; ++i)
+    {
+        drag({ mNodes[0] }, QPointF(i % 2 ? step : -step, step), i);
+        positions.append(mModel.nodePosition(mNodes[0]));
+    }
+
+    // the stack drops the oldest commands, the budget releases the next ones
+    QCOMPARE(mStack->count(), mStack->undoLimit());
+
+    int released = 0;
+    while (released < mStack->count() && mStack->command(released)->isObsolete())
+        ++released;
+
+    const int live = mStack->count() - released;
+    QVERIFY(released > 0);
+    QVERIFY(live > 0 && live <= 4);
+
+    // undo never stops at a released command, they go once undo reaches them
+    for (int i=1; i<=live; ++i)
+    {
+        QVERIFY(mStack->canUndo());
+        mStack->undo();
+        QCOMPARE(mModel.nodePosition(mNodes[0]), positions[moves - i]);
+    }
+
+    QVERIFY(!mStack->canUndo());
+    QCOMPARE(mStack->count(), live);
+
+    for (int i=0; i<mStack->count(); ++i)
+        QVERIFY(!mStack->command(i)->isObsolete());
+}
+
+// ----------------------------------------------------------------------------
+
+QTEST_MAIN(TestUndo)
+
+#include "tst_undo.moc"
+
+// ----------------------------------------------------------------------------